@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <utility>
+#include "alloc.h"
+
+namespace OWL
+{
+    /**
+     * @brief Fixed-size array of trivially copyable T, 64-byte aligned for SIMD loads.
+     * @details Used for struct-of-arrays storage. The size is rounded up to a whole
+     * cache line, so kernels can run over full vectors past the last element.
+     */
+    template <typename T>
+    class AlignedArray
+    {
+    public:
+        AlignedArray() {}
+        explicit AlignedArray(size_t n) { resize(n); }
+        ~AlignedArray() { alignedFree(items); }
+        AlignedArray(const AlignedArray &) = delete;
+        AlignedArray &operator=(const AlignedArray &) = delete;
+        AlignedArray(AlignedArray &&other) noexcept : items{other.items}, n{other.n}
+        {
+            other.items = nullptr;
+            other.n = 0;
+        }
+        AlignedArray &operator=(AlignedArray &&other) noexcept
+        {
+            std::swap(items, other.items);
+            std::swap(n, other.n);
+            return *this;
+        }
+
+        /// Reallocate to hold n elements, all zeroed. Old contents are dropped.
+        /// Returns false, leaving the array empty, if the memory can't be allocated.
+        bool resize(size_t count)
+        {
+            alignedFree(items);
+            size_t bytes = (count * sizeof(T) + 63) & ~(size_t)63;
+            items = static_cast<T *>(alignedAlloc(bytes > 0 ? bytes : 64, 64));
+            if (items == nullptr)
+            {
+                n = 0;
+                return false;
+            }
+            memset(items, 0, bytes > 0 ? bytes : 64);
+            n = count;
+            return true;
+        }
+
+        T &operator[](size_t i) { return items[i]; }
+        const T &operator[](size_t i) const { return items[i]; }
+        T *data() { return items; }
+        const T *data() const { return items; }
+        size_t size() const { return n; }
+
+    private:
+        T *items{nullptr};
+        size_t n{0};
+    };
+
+} // namespace OWL
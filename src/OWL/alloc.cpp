@@ -0,0 +1,193 @@
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstddef>
+#include <atomic>
+#include <new>
+
+namespace OWL
+{
+    static std::atomic<uint64_t> allocations{0};
+    static std::atomic<uint64_t> allocatedBytes{0};
+    static std::atomic<uint64_t> deallocations{0};
+    static thread_local uint64_t threadAllocations = 0;
+
+    uint64_t allocationCount() { return allocations.load(std::memory_order_relaxed); }
+    uint64_t allocationBytes() { return allocatedBytes.load(std::memory_order_relaxed); }
+    uint64_t deallocationCount() { return deallocations.load(std::memory_order_relaxed); }
+    uint64_t threadAllocationCount() { return threadAllocations; }
+
+    //=== tags ====================================================================
+
+    static const int tagCount = (int)MemoryTag::COUNT;
+
+    /// Live and high-water bytes of one tag, updated from any thread.
+    struct TagCounters
+    {
+        std::atomic<int64_t> live{0};
+        std::atomic<int64_t> highWater{0};
+        std::atomic<uint64_t> allocations{0};
+
+        void add(int64_t bytes)
+        {
+            int64_t now = live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            if (bytes <= 0)
+                return;
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            int64_t high = highWater.load(std::memory_order_relaxed);
+            while (now > high && !highWater.compare_exchange_weak(high, now, std::memory_order_relaxed))
+                ;
+        }
+
+        MemoryUsage usage() const
+        {
+            return {live.load(std::memory_order_relaxed), highWater.load(std::memory_order_relaxed),
+                    allocations.load(std::memory_order_relaxed)};
+        }
+    };
+
+    static TagCounters heapCounters[tagCount];
+    static TagCounters gpuCounters[tagCount];
+    // trivially initialized, so it is usable by allocations before main
+    static thread_local uint8_t currentTag = (uint8_t)MemoryTag::OTHER;
+
+    const char *memoryTagName(MemoryTag tag)
+    {
+        static const char *names[tagCount] = {"other", "render", "text", "console", "bus", "audio", "save", "telemetry"};
+        return names[(int)tag];
+    }
+
+    MemoryScope::MemoryScope(MemoryTag tag) : previous{(MemoryTag)currentTag}
+    {
+        currentTag = (uint8_t)tag;
+    }
+
+    MemoryScope::~MemoryScope()
+    {
+        currentTag = (uint8_t)previous;
+    }
+
+    MemoryTag MemoryScope::current() { return (MemoryTag)currentTag; }
+
+    MemoryUsage heapUsage(MemoryTag tag) { return heapCounters[(int)tag].usage(); }
+    MemoryUsage gpuUsage(MemoryTag tag) { return gpuCounters[(int)tag].usage(); }
+
+    void trackTextureBytes(MemoryTag tag, int64_t bytes)
+    {
+        gpuCounters[(int)tag].add(bytes);
+    }
+
+    static std::string formatBytes(int64_t bytes)
+    {
+        char text[32];
+        if (bytes >= 10 << 20 || bytes <= -(10 << 20))
+            snprintf(text, sizeof(text), "%lld MB", (long long)(bytes >> 20));
+        else if (bytes >= 10 << 10 || bytes <= -(10 << 10))
+            snprintf(text, sizeof(text), "%lld KB", (long long)(bytes >> 10));
+        else
+            snprintf(text, sizeof(text), "%lld B", (long long)bytes);
+        return text;
+    }
+
+    std::vector<std::string> memoryReport()
+    {
+        std::vector<std::string> lines;
+        int64_t heap = 0, gpu = 0;
+        char line[160];
+        for (int i = 0; i < tagCount; i++)
+        {
+            MemoryUsage h = heapCounters[i].usage(), g = gpuCounters[i].usage();
+            heap += h.live, gpu += g.live;
+            snprintf(line, sizeof(line), "%-9s heap %8s (high %8s, %llu allocs)  textures %8s (high %8s)",
+                     memoryTagName((MemoryTag)i), formatBytes(h.live).c_str(), formatBytes(h.highWater).c_str(),
+                     (unsigned long long)h.allocations, formatBytes(g.live).c_str(), formatBytes(g.highWater).c_str());
+            lines.push_back(line);
+        }
+        lines.push_back("total     heap " + formatBytes(heap) + ", textures " + formatBytes(gpu));
+        return lines;
+    }
+
+    //=== operator new/delete =====================================================
+
+    /**
+     * Every allocation starts with a header right before the returned pointer. It holds the
+     * size and tag to credit on free, and how far the pointer is from the start of the block.
+     * Its size keeps the returned pointer aligned for any type.
+     */
+    struct alignas(std::max_align_t) Header
+    {
+        uint64_t size;
+        uint32_t offset;
+        uint8_t tag;
+    };
+    static_assert(sizeof(Header) == alignof(std::max_align_t), "the header must keep allocations aligned");
+
+    static void *countedAlloc(size_t size, size_t alignment)
+    {
+        if (size == 0)
+            size = 1;
+        size_t offset = alignment > sizeof(Header) ? alignment : sizeof(Header);
+        char *block;
+        if (alignment > alignof(std::max_align_t))
+            block = (char *)aligned_alloc(alignment, offset + ((size + alignment - 1) & ~(alignment - 1)));
+        else
+            block = (char *)malloc(offset + size);
+        if (block == nullptr)
+            return nullptr;
+        Header *header = (Header *)(block + offset) - 1;
+        header->size = size;
+        header->offset = (uint32_t)offset;
+        header->tag = currentTag;
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        threadAllocations++;
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        heapCounters[header->tag].add((int64_t)size);
+        return block + offset;
+    }
+
+    static void countedFree(void *p)
+    {
+        if (p == nullptr)
+            return;
+        Header *header = (Header *)p - 1;
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        heapCounters[header->tag].add(-(int64_t)header->size);
+        free((char *)p - header->offset);
+    }
+
+    void *alignedAlloc(size_t size, size_t alignment) { return countedAlloc(size, alignment); }
+    void alignedFree(void *p) { countedFree(p); }
+} // namespace OWL
+
+//=== global operator new/delete replacements ===
+
+void *operator new(size_t size)
+{
+    void *p = OWL::countedAlloc(size, alignof(std::max_align_t));
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return OWL::countedAlloc(size, alignof(std::max_align_t)); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return OWL::countedAlloc(size, alignof(std::max_align_t)); }
+
+void *operator new(size_t size, std::align_val_t al)
+{
+    void *p = OWL::countedAlloc(size, static_cast<size_t>(al));
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size, std::align_val_t al) { return operator new(size, al); }
+
+void operator delete(void *p) noexcept { OWL::countedFree(p); }
+void operator delete[](void *p) noexcept { OWL::countedFree(p); }
+void operator delete(void *p, size_t) noexcept { OWL::countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { OWL::countedFree(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { OWL::countedFree(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { OWL::countedFree(p); }
+void operator delete(void *p, std::align_val_t) noexcept { OWL::countedFree(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { OWL::countedFree(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { OWL::countedFree(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { OWL::countedFree(p); }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace OWL
+{
+    /**
+     * @brief Global heap allocation counters.
+     * @details alloc.cpp replaces the global operator new/delete, so every C++ heap
+     * allocation in the program is counted, and so is alignedAlloc(). These totals include
+     * every thread. Memory that SDL allocates with malloc is not counted.
+     */
+    uint64_t allocationCount();
+    uint64_t allocationBytes();
+    uint64_t deallocationCount();
+    /// Allocations made by the calling thread. Compare it at the start and end of a frame to see how many the frame made.
+    uint64_t threadAllocationCount();
+
+    /// Heap memory aligned to alignment (a power of two), counted and tagged like operator new.
+    /// Returns NULL if it can't be allocated. Release it with alignedFree().
+    void *alignedAlloc(size_t size, size_t alignment);
+    void alignedFree(void *p);
+
+    /// Subsystems memory is accounted to.
+    enum class MemoryTag : uint8_t
+    {
+        OTHER,
+        RENDER,
+        TEXT, // Draw::writeText
+        CONSOLE,
+        BUS, // queued and delayed messages
+        AUDIO,
+        SAVE,
+        TELEMETRY,
+        COUNT
+    };
+
+    const char *memoryTagName(MemoryTag tag);
+
+    /**
+     * @brief Accounts the heap allocations of this thread to a tag while it lives.
+     * @details Scopes nest, the innermost wins. Every allocation remembers its tag in a
+     * small header, so freeing it credits the right tag whatever scope or thread frees it.
+     * Allocations outside any scope count as OTHER.
+     */
+    class MemoryScope
+    {
+    public:
+        explicit MemoryScope(MemoryTag tag);
+        ~MemoryScope();
+        MemoryScope(const MemoryScope &) = delete;
+        MemoryScope &operator=(const MemoryScope &) = delete;
+
+        static MemoryTag current();
+
+    private:
+        MemoryTag previous;
+    };
+
+    struct MemoryUsage
+    {
+        int64_t live;       // bytes
+        int64_t highWater;  // most bytes live at once
+        uint64_t allocations;
+    };
+
+    /// Heap bytes of one tag, as requested from operator new.
+    MemoryUsage heapUsage(MemoryTag tag);
+    /// Estimated texture memory of one tag, see trackTextureBytes().
+    MemoryUsage gpuUsage(MemoryTag tag);
+    /// Account a texture created (bytes > 0) or destroyed (bytes < 0) to tag.
+    void trackTextureBytes(MemoryTag tag, int64_t bytes);
+
+    /// One line per tag with live and high-water heap and texture bytes, then the totals.
+    std::vector<std::string> memoryReport();
+
+} // namespace OWL
@@ -0,0 +1,299 @@
+#include "animation.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include "draw.h"
+
+namespace OWL
+{
+    // frames shorter than this would let one update step through a clip many times over
+    static const float minFrameTime = 0.001f;
+    static const float never = std::numeric_limits<float>::infinity();
+
+    AnimationClip AnimationClip::grid(TextureHandle atlas, int x, int y, int w, int h, int columns, int count,
+                                      float frameTime, LoopMode loop)
+    {
+        AnimationClip clip;
+        clip.atlas = atlas;
+        clip.loop = loop;
+        for (int i = 0; i < count; i++)
+        {
+            clip.frames.push_back({x + i % columns * w, y + i / columns * h, w, h});
+            clip.durations.push_back(frameTime);
+        }
+        return clip;
+    }
+
+    int AnimationSystem::addClip(const AnimationClip &clip)
+    {
+        assert(!clip.frames.empty() && clip.frames.size() == clip.durations.size());
+        Clip c;
+        c.source = clip;
+        c.first = (uint32_t)frameRects.size();
+        c.count = (uint32_t)clip.frames.size();
+        c.length = 0.0f;
+        c.loop = clip.loop;
+        for (size_t i = 0; i < clip.frames.size(); i++)
+        {
+            float duration = std::max(clip.durations[i], minFrameTime);
+            frameRects.push_back(clip.frames[i]);
+            frameDurations.push_back(duration);
+            c.length += duration;
+        }
+
+        c.layer = 0;
+        while (c.layer < layers.size() && layers[c.layer].atlas != clip.atlas)
+            c.layer++;
+        if (c.layer == layers.size())
+        {
+            layers.emplace_back();
+            layers.back().atlas = clip.atlas;
+        }
+        clips.push_back(c);
+        return (int)clips.size() - 1;
+    }
+
+    //=== instances ===============================================================
+
+    const AnimationSystem::Slot *AnimationSystem::find(AnimationHandle instance) const
+    {
+        if (instance.isNull() || instance.index() >= slots.size())
+            return nullptr;
+        const Slot &slot = slots[instance.index()];
+        return slot.generation == instance.generation() ? &slot : nullptr;
+    }
+
+    bool AnimationSystem::isValid(AnimationHandle instance) const
+    {
+        return find(instance) != nullptr;
+    }
+
+    uint32_t AnimationSystem::insert(size_t layer, uint32_t slot, int clip, float x, float y, float scale, float speed, SDL_Color color)
+    {
+        Layer &l = layers[layer];
+        uint32_t i = (uint32_t)l.clip.size();
+        l.clip.push_back(clip);
+        l.frame.push_back(0);
+        l.remaining.push_back(0.0f);
+        l.speed.push_back(std::max(speed, 0.0f));
+        l.scale.push_back(scale);
+        l.flags.push_back(0);
+        l.slot.push_back(slot);
+        l.sprites.push_back({{x, y, 0.0f, 0.0f}, {0, 0, 0, 0}, color});
+        restart(l, i);
+        return i;
+    }
+
+    void AnimationSystem::erase(size_t layer, uint32_t index)
+    {
+        // order within a layer doesn't matter, so the last instance fills the gap
+        Layer &l = layers[layer];
+        size_t last = l.clip.size() - 1;
+        if (index != last)
+        {
+            l.clip[index] = l.clip[last], l.frame[index] = l.frame[last], l.remaining[index] = l.remaining[last];
+            l.speed[index] = l.speed[last], l.scale[index] = l.scale[last], l.flags[index] = l.flags[last];
+            l.slot[index] = l.slot[last], l.sprites[index] = l.sprites[last];
+            slots[l.slot[index]].index = index;
+        }
+        l.clip.pop_back(), l.frame.pop_back(), l.remaining.pop_back();
+        l.speed.pop_back(), l.scale.pop_back(), l.flags.pop_back();
+        l.slot.pop_back(), l.sprites.pop_back();
+    }
+
+    AnimationHandle AnimationSystem::spawn(int clip, float x, float y, float scale, float speed)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)slots.size();
+            assert(slot <= AnimationHandle::indexMask && "too many animation instances");
+            slots.push_back({0, 0, 1});
+        }
+        size_t layer = clips[clip].layer;
+        slots[slot].layer = (uint32_t)layer;
+        slots[slot].index = insert(layer, slot, clip, x, y, scale, speed, {255, 255, 255, 255});
+        return AnimationHandle::make(slot, slots[slot].generation);
+    }
+
+    void AnimationSystem::remove(AnimationHandle instance)
+    {
+        const Slot *slot = find(instance);
+        if (slot == nullptr)
+            return;
+        erase(slot->layer, slot->index);
+        // skip generation 0 on wrap-around so the null handle stays unique
+        uint32_t &generation = slots[instance.index()].generation;
+        generation = (generation + 1) & AnimationHandle::generationMask;
+        if (generation == 0)
+            generation = 1;
+        freeSlots.push_back(instance.index());
+    }
+
+    void AnimationSystem::play(AnimationHandle instance, int clip)
+    {
+        const Slot *slot = find(instance);
+        if (slot == nullptr)
+            return;
+        Layer &l = layers[slot->layer];
+        size_t i = slot->index;
+        if (clips[clip].layer == slot->layer)
+        {
+            l.clip[i] = clip;
+            restart(l, i);
+            return;
+        }
+
+        // another atlas: move the instance over to that layer
+        const Sprite sprite = l.sprites[i];
+        float scale = l.scale[i], speed = l.speed[i];
+        erase(slot->layer, slot->index);
+        Slot &moved = slots[instance.index()];
+        moved.layer = (uint32_t)clips[clip].layer;
+        moved.index = insert(moved.layer, instance.index(), clip, sprite.dst.x, sprite.dst.y, scale, speed, sprite.color);
+    }
+
+    void AnimationSystem::setPosition(AnimationHandle instance, float x, float y)
+    {
+        if (const Slot *slot = find(instance))
+        {
+            SDL_FRect &dst = layers[slot->layer].sprites[slot->index].dst;
+            dst.x = x;
+            dst.y = y;
+        }
+    }
+
+    void AnimationSystem::setSpeed(AnimationHandle instance, float speed)
+    {
+        if (const Slot *slot = find(instance))
+            layers[slot->layer].speed[slot->index] = std::max(speed, 0.0f);
+    }
+
+    void AnimationSystem::setColor(AnimationHandle instance, SDL_Color color)
+    {
+        if (const Slot *slot = find(instance))
+            layers[slot->layer].sprites[slot->index].color = color;
+    }
+
+    bool AnimationSystem::isFinished(AnimationHandle instance) const
+    {
+        const Slot *slot = find(instance);
+        return slot != nullptr && (layers[slot->layer].flags[slot->index] & FINISHED);
+    }
+
+    //=== playback ================================================================
+
+    void AnimationSystem::restart(Layer &layer, size_t i)
+    {
+        layer.flags[i] = 0;
+        layer.remaining[i] = frameDurations[clips[layer.clip[i]].first];
+        setFrame(layer, i, 0);
+    }
+
+    void AnimationSystem::setFrame(Layer &layer, size_t i, uint32_t frame)
+    {
+        const SDL_Rect &rect = frameRects[clips[layer.clip[i]].first + frame];
+        Sprite &sprite = layer.sprites[i];
+        layer.frame[i] = frame;
+        sprite.src = rect;
+        sprite.dst.w = rect.w * layer.scale[i];
+        sprite.dst.h = rect.h * layer.scale[i];
+    }
+
+    void AnimationSystem::advance(Layer &layer, size_t i)
+    {
+        const Clip &clip = clips[layer.clip[i]];
+        const float *durations = &frameDurations[clip.first];
+        float remaining = layer.remaining[i];
+        uint32_t frame = layer.frame[i];
+        uint8_t flags = layer.flags[i];
+
+        // a long pause or a high speed could skip whole loops, only the leftover matters
+        if (clip.loop == LoopMode::LOOP && -remaining > clip.length)
+            remaining = fmodf(remaining, clip.length);
+
+        while (remaining <= 0.0f)
+        {
+            if (flags & REVERSE)
+            {
+                if (frame > 0)
+                    frame--;
+                else
+                {
+                    flags &= ~REVERSE;
+                    frame = std::min(1u, clip.count - 1);
+                }
+            }
+            else if (frame + 1 < clip.count)
+                frame++;
+            else if (clip.loop == LoopMode::LOOP)
+                frame = 0;
+            else if (clip.loop == LoopMode::PING_PONG && clip.count > 1)
+            {
+                flags |= REVERSE;
+                frame = clip.count - 2;
+            }
+            else if (clip.loop == LoopMode::PING_PONG)
+                frame = 0;
+            else
+            {
+                // ONCE: hold the last frame, and never come back here
+                flags |= FINISHED;
+                remaining = never;
+                break;
+            }
+            remaining += durations[frame];
+        }
+
+        layer.flags[i] = flags;
+        layer.remaining[i] = remaining;
+        if (frame != layer.frame[i])
+            setFrame(layer, i, frame);
+    }
+
+    void AnimationSystem::update(float dt)
+    {
+        for (auto &layer : layers)
+        {
+            size_t n = layer.clip.size();
+            float *remaining = layer.remaining.data();
+            const float *speed = layer.speed.data();
+            // one pass counts down every instance and lists the ones whose frame is up, without
+            // branching. Most are still inside their frame, only the listed ones take the slow path.
+            due.resize(n);
+            uint32_t *list = due.data();
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                float r = remaining[i] - speed[i] * dt;
+                remaining[i] = r;
+                list[count] = (uint32_t)i;
+                count += r <= 0.0f;
+            }
+            for (size_t k = 0; k < count; k++)
+                advance(layer, list[k]);
+        }
+    }
+
+    void AnimationSystem::render(Draw &draw)
+    {
+        for (const auto &layer : layers)
+            if (!layer.sprites.empty())
+                draw.drawSprites(layer.atlas, layer.sprites.data(), (int)layer.sprites.size());
+    }
+
+    size_t AnimationSystem::instanceCount() const
+    {
+        size_t total = 0;
+        for (const auto &layer : layers)
+            total += layer.clip.size();
+        return total;
+    }
+
+} // namespace OWL
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vector>
+#include "backend.h"
+#include "pool.h"
+
+namespace OWL
+{
+    class Draw;
+
+    enum class LoopMode
+    {
+        ONCE,     // stop on the last frame
+        LOOP,     // start over from the first frame
+        PING_PONG // play backwards to the first frame, then forwards again
+    };
+
+    /**
+     * @brief An animation: a run of frames from one atlas texture.
+     * @param frames source rect of every frame in the atlas
+     * @param durations seconds each frame is shown, one per frame
+     */
+    struct AnimationClip
+    {
+        TextureHandle atlas;
+        std::vector<SDL_Rect> frames;
+        std::vector<float> durations;
+        LoopMode loop{LoopMode::LOOP};
+
+        /// count frames of w x h laid out left to right, top to bottom from (x, y) in rows of columns.
+        static AnimationClip grid(TextureHandle atlas, int x, int y, int w, int h, int columns, int count,
+                                  float frameTime, LoopMode loop = LoopMode::LOOP);
+    };
+
+    struct AnimationTag;
+    typedef Handle<AnimationTag> AnimationHandle;
+
+    /**
+     * @brief Plays sprite animations for many instances at once.
+     * @details Clips are added once and shared by every instance that plays them; they
+     * never change afterwards. All their frames live in one flat table.
+     *
+     * Instances are grouped by atlas texture. Their playback state is kept as parallel
+     * arrays, and each group has a sprite batch with one quad per instance: the render
+     * queue. update() advances every instance in one pass and only writes a new source
+     * rect into the queue when an instance moves to another frame. render() then draws
+     * each atlas with a single drawSprites call, nothing is rebuilt per frame.
+     *
+     * Instances are addressed by generational handles. Removing one moves the last
+     * instance of its group into its place.
+     */
+    class AnimationSystem
+    {
+    public:
+        /// Add a shared clip. Returns its id.
+        int addClip(const AnimationClip &clip);
+        const AnimationClip &getClip(int id) const { return clips[id].source; }
+
+        /// Start playing a clip at (x, y), the top left of the quad. speed multiplies the clip's frame rate.
+        AnimationHandle spawn(int clip, float x, float y, float scale = 1.0f, float speed = 1.0f);
+        void remove(AnimationHandle instance);
+        bool isValid(AnimationHandle instance) const;
+
+        /// Switch to another clip from its first frame.
+        void play(AnimationHandle instance, int clip);
+        void setPosition(AnimationHandle instance, float x, float y);
+        /// 0 pauses.
+        void setSpeed(AnimationHandle instance, float speed);
+        void setColor(AnimationHandle instance, SDL_Color color);
+        /// A ONCE clip that reached its last frame.
+        bool isFinished(AnimationHandle instance) const;
+
+        /// Advance every instance by dt seconds.
+        void update(float dt);
+        void render(Draw &draw);
+
+        size_t instanceCount() const;
+        size_t layerCount() const { return layers.size(); }
+        /// Render queue of one atlas, one sprite per instance.
+        const std::vector<Sprite> &getQueue(size_t layer) const { return layers[layer].sprites; }
+
+    private:
+        struct Clip
+        {
+            AnimationClip source;
+            uint32_t first; // in frameRects and frameDurations
+            uint32_t count;
+            float length;   // seconds for one pass through the frames
+            LoopMode loop;
+            size_t layer;
+        };
+        enum Flags : uint8_t
+        {
+            REVERSE = 1, // playing a PING_PONG clip backwards
+            FINISHED = 2
+        };
+        /// All instances drawing from one atlas, as parallel arrays.
+        struct Layer
+        {
+            TextureHandle atlas;
+            std::vector<uint32_t> clip, frame; // frame within the clip
+            std::vector<float> remaining;      // seconds until the next frame
+            std::vector<float> speed, scale;
+            std::vector<uint8_t> flags;
+            std::vector<uint32_t> slot;  // back reference into slots
+            std::vector<Sprite> sprites; // the render queue
+        };
+        struct Slot
+        {
+            uint32_t layer;
+            uint32_t index;
+            uint32_t generation;
+        };
+
+        std::vector<Clip> clips;
+        std::vector<SDL_Rect> frameRects;
+        std::vector<float> frameDurations;
+        std::vector<Layer> layers;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+        std::vector<uint32_t> due; // reused list of instances to advance
+
+        const Slot *find(AnimationHandle instance) const;
+        /// Append an instance to a layer at the start of clip.
+        uint32_t insert(size_t layer, uint32_t slot, int clip, float x, float y, float scale, float speed, SDL_Color color);
+        void erase(size_t layer, uint32_t index);
+        /// Step to the frame that is due, then update the instance's sprite.
+        void advance(Layer &layer, size_t i);
+        /// Back to the first frame of the instance's clip.
+        void restart(Layer &layer, size_t i);
+        /// Show frame, writing its source rect and size into the render queue.
+        void setFrame(Layer &layer, size_t i, uint32_t frame);
+    };
+
+} // namespace OWL
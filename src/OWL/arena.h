@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace OWL
+{
+    /**
+     * @brief Per-frame linear (bump) allocator.
+     * @details Memory for throwaway per-frame data is taken from one preallocated block
+     * by bumping an offset, and everything is given back at once with reset() at the end
+     * of the frame. Deallocating single blocks does nothing.
+     * It is a std::pmr::memory_resource, so pmr strings and vectors can use it directly
+     * through frame_string and frame_vector. When the block runs out, allocations
+     * spill over to the upstream resource and are counted in overflowCount().
+     *
+     * @param capacity size of the preallocated block in bytes
+     */
+    class FrameArena : public std::pmr::memory_resource
+    {
+    public:
+        explicit FrameArena(size_t capacity = 256 * 1024,
+                            std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : buffer{static_cast<char *>(upstream->allocate(capacity, alignof(std::max_align_t)))},
+              capacity{capacity}, upstream{upstream} {}
+        ~FrameArena() { upstream->deallocate(buffer, capacity, alignof(std::max_align_t)); }
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        /// Release everything allocated this frame. Nothing allocated from the arena may be used after this.
+        void reset()
+        {
+            if (offset > highWater)
+                highWater = offset;
+            offset = 0;
+            overflows = 0;
+        }
+
+        size_t used() const { return offset; }
+        size_t highWaterMark() const { return highWater > offset ? highWater : offset; }
+        size_t size() const { return capacity; }
+        /// Allocations this frame that didn't fit and went to the upstream resource.
+        size_t overflowCount() const { return overflows; }
+
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override
+        {
+            size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + bytes > capacity)
+            {
+                overflows++;
+                return upstream->allocate(bytes, alignment);
+            }
+            offset = start + bytes;
+            return buffer + start;
+        }
+
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override
+        {
+            // only the blocks that spilled over are freed one by one
+            if (p < buffer || p >= buffer + capacity)
+                upstream->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    private:
+        char *buffer;
+        size_t capacity;
+        size_t offset{0};
+        size_t highWater{0};
+        size_t overflows{0};
+        std::pmr::memory_resource *upstream;
+    };
+
+    /// The arena that Game resets at the end of every frame.
+    inline FrameArena &frameArena()
+    {
+        static FrameArena arena;
+        return arena;
+    }
+
+    //=== pmr adapters for transient data. Never keep these past the end of the frame. ===
+    typedef std::pmr::string frame_string;
+    template <typename T>
+    using frame_vector = std::pmr::vector<T>;
+
+    inline frame_string makeFrameString() { return frame_string(&frameArena()); }
+
+    template <typename T>
+    frame_vector<T> makeFrameVector() { return frame_vector<T>(&frameArena()); }
+
+} // namespace OWL
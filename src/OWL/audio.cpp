@@ -0,0 +1,155 @@
+#include "audio.h"
+#include <stdio.h>
+#include <string.h>
+#include "alloc.h"
+
+namespace OWL
+{
+    Audio::Audio(std::shared_ptr<MessageBus> msgBus, int sampleRate, int bufferFrames)
+        : BusNode(msgBus, "Audio")
+    {
+        MemoryScope scope(MemoryTag::AUDIO);
+        SDL_AudioSpec want{}, have{};
+        want.freq = sampleRate;
+        want.format = AUDIO_F32SYS;
+        want.channels = 2;
+        want.samples = bufferFrames;
+        want.callback = callback;
+        want.userdata = this;
+
+        // the device starts paused, so the mixer can be made for the rate it actually got
+        initialized = SDL_InitSubSystem(SDL_INIT_AUDIO) == 0;
+        if (!initialized)
+            printf("SDL audio could not initialize! SDL_Error: %s\n", SDL_GetError());
+        else if ((device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE)) == 0)
+            printf("Audio device could not be opened! SDL_Error: %s\n", SDL_GetError());
+
+        mixer = std::make_unique<Mixer>(device != 0 ? have.freq : sampleRate);
+        if (device != 0)
+        {
+            SDL_PauseAudioDevice(device, 0);
+            send({"Audio: " + std::string(SDL_GetCurrentAudioDriver()) + ", " + std::to_string(have.freq) + " Hz, " +
+                  std::to_string(have.samples) + " frame buffer"});
+        }
+    }
+
+    Audio::~Audio()
+    {
+        // stop the callback before the mixer and the samples it points to go away
+        if (device != 0)
+            SDL_CloseAudioDevice(device);
+        if (initialized)
+            SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+
+    void Audio::callback(void *userdata, Uint8 *stream, int len)
+    {
+        static_cast<Audio *>(userdata)->mixer->process(reinterpret_cast<float *>(stream), len / (2 * sizeof(float)));
+    }
+
+    SoundHandle Audio::load(const std::string &path)
+    {
+        MemoryScope scope(MemoryTag::AUDIO);
+        auto cached = loaded.find(path);
+        if (cached != loaded.end())
+            return cached->second;
+
+        SDL_AudioSpec spec;
+        Uint8 *buffer = nullptr;
+        Uint32 length = 0;
+        if (SDL_LoadWAV(path.c_str(), &spec, &buffer, &length) == NULL)
+        {
+            printf("Unable to load sound %s! SDL_Error: %s\n", path.c_str(), SDL_GetError());
+            return SoundHandle();
+        }
+
+        SDL_AudioCVT cvt;
+        if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, 2, getSampleRate()) < 0)
+        {
+            printf("Unable to convert sound %s! SDL_Error: %s\n", path.c_str(), SDL_GetError());
+            SDL_FreeWAV(buffer);
+            return SoundHandle();
+        }
+        cvt.len = length;
+        cvt.buf = static_cast<Uint8 *>(SDL_malloc((size_t)length * cvt.len_mult));
+        memcpy(cvt.buf, buffer, length);
+        SDL_FreeWAV(buffer);
+        SDL_ConvertAudio(&cvt);
+
+        SoundHandle sound = create(reinterpret_cast<const float *>(cvt.buf), cvt.len_cvt / (2 * sizeof(float)));
+        SDL_free(cvt.buf);
+        loaded[path] = sound;
+        return sound;
+    }
+
+    SoundHandle Audio::create(const float *stereo, int frames)
+    {
+        MemoryScope scope(MemoryTag::AUDIO);
+        Sample *sample = new Sample;
+        if (!sample->data.resize((size_t)frames * 2))
+        {
+            printf("Unable to allocate a sound of %d frames!\n", frames);
+            delete sample;
+            return SoundHandle();
+        }
+        memcpy(sample->data.data(), stereo, (size_t)frames * 2 * sizeof(float));
+        sample->frames = frames;
+        return samples.add(sample);
+    }
+
+    bool Audio::push(const AudioCommand &command)
+    {
+        if (mixer->push(command))
+            return true;
+        dropped++;
+        return false;
+    }
+
+    VoiceId Audio::play(SoundHandle sound, float volume, float pan, bool loop)
+    {
+        const Sample *sample = samples.get(sound);
+        if (sample == nullptr)
+            return 0;
+        VoiceId voice = nextVoice++;
+        if (nextVoice == 0)
+            nextVoice = 1;
+        return push({AudioCommand::PLAY, voice, sample, volume, pan, loop}) ? voice : 0;
+    }
+
+    void Audio::stop(VoiceId voice)
+    {
+        push({AudioCommand::STOP, voice, nullptr, 0.0f, 0.0f, false});
+    }
+
+    void Audio::setGain(VoiceId voice, float volume, float pan)
+    {
+        push({AudioCommand::SET_GAIN, voice, nullptr, volume, pan, false});
+    }
+
+    void Audio::stopAll()
+    {
+        push({AudioCommand::STOP_ALL, 0, nullptr, 0.0f, 0.0f, false});
+    }
+
+    void Audio::setMasterVolume(float volume)
+    {
+        push({AudioCommand::SET_MASTER, 0, nullptr, volume, 0.0f, false});
+    }
+
+    void Audio::onNotify(const Message &msg)
+    {
+        const std::string &text = msg.getParameter(0);
+        if (text == ":audio")
+        {
+            MixerStats s = stats();
+            char line[200];
+            snprintf(line, sizeof(line), "audio: %d voices, callback %.1f us avg %.1f us max of %.0f us, %llu underruns, %llu dropped",
+                     s.voices, s.averageMicros, s.maxMicros, s.budgetMicros, (unsigned long long)s.underruns,
+                     (unsigned long long)(s.droppedVoices + dropped));
+            send({line});
+        }
+        else if (text.compare(0, 6, ":play ") == 0)
+            play(load(text.substr(6)));
+    }
+
+} // namespace OWL
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "mixer.h"
+#include "msg.h"
+#include "pool.h"
+
+namespace OWL
+{
+    /**
+     * @brief Sound output: an SDL audio device, the sample cache and the Mixer that runs in its callback.
+     * @details Sounds are decoded once into the cache as stereo float at the device rate,
+     * so the mixer only ever adds and scales samples. All calls here run on the game thread
+     * and reach the mixer through its lock-free command queue; nothing here waits for the
+     * audio thread. Cached sounds stay alive as long as the Audio does, because the mixer
+     * holds plain pointers to them.
+     * Any SDL audio driver works, including the dummy and disk drivers (SDL_AUDIODRIVER=dummy).
+     *
+     * Console commands: ":audio" prints the mixer stats, ":play <file.wav>" plays a file.
+     *
+     * @param sampleRate,bufferFrames requested device format; the device may pick another rate
+     */
+    class Audio : public BusNode
+    {
+    public:
+        Audio(std::shared_ptr<MessageBus> msgBus, int sampleRate = 48000, int bufferFrames = 512);
+        ~Audio();
+        Audio(const Audio &) = delete;
+        Audio &operator=(const Audio &) = delete;
+
+        /// Decode a WAV file into the cache. Loading the same path again returns the cached sound.
+        SoundHandle load(const std::string &path);
+        /// Add interleaved stereo float frames at getSampleRate() to the cache. Returns a null handle if they can't be allocated.
+        SoundHandle create(const float *stereo, int frames);
+
+        /// Start playing a sound. Returns 0 if the command queue is full.
+        VoiceId play(SoundHandle sound, float volume = 1.0f, float pan = 0.0f, bool loop = false);
+        void stop(VoiceId voice);
+        void setGain(VoiceId voice, float volume, float pan);
+        void stopAll();
+        void setMasterVolume(float volume);
+
+        MixerStats stats() const { return mixer->stats(); }
+        /// Commands dropped because the queue was full.
+        uint64_t droppedCommands() const { return dropped; }
+        int getSampleRate() const { return mixer->getSampleRate(); }
+        bool isOpen() const { return device != 0; }
+
+    private:
+        bool initialized{false}; // SDL's audio subsystem, quit again in the destructor
+        SDL_AudioDeviceID device{0};
+        std::unique_ptr<Mixer> mixer;
+        ResourcePool<Sample, Sample, std::default_delete<Sample>> samples;
+        std::unordered_map<std::string, SoundHandle> loaded; // path -> cached sound
+        VoiceId nextVoice{1};
+        uint64_t dropped{0};
+
+        bool push(const AudioCommand &command);
+        static void callback(void *userdata, Uint8 *stream, int len);
+
+        void onNotify(const Message &msg);
+    };
+
+} // namespace OWL
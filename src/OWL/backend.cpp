@@ -0,0 +1,14 @@
+#include "backend.h"
+#include "cpu_backend.h"
+#include "sdl_backend.h"
+
+namespace OWL
+{
+    std::unique_ptr<RenderBackend> createRenderBackend(RenderBackendType type, SDL_Window *window, int w, int h)
+    {
+        if (type == RenderBackendType::CPU)
+            return std::unique_ptr<RenderBackend>(new CpuBackend(window, w, h));
+        return std::unique_ptr<RenderBackend>(new SdlBackend(window));
+    }
+
+} // namespace OWL
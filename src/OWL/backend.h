@@ -0,0 +1,83 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <memory>
+#include "capture.h"
+#include "pool.h"
+
+namespace OWL
+{
+    enum class RenderBackendType
+    {
+        SDL, // SDL_Renderer, whatever driver SDL picks
+        CPU  // software rasterizer into an RGBA framebuffer, see cpu_backend.h
+    };
+
+    /**
+     * @brief One tinted quad of a sprite batch.
+     * @param dst destination in viewport coordinates
+     * @param src source rect in the texture, a zero width means the whole texture
+     * @param color tint multiplied with the texture, or the fill color without a texture
+     */
+    struct Sprite
+    {
+        SDL_FRect dst;
+        SDL_Rect src;
+        SDL_Color color;
+    };
+
+    /**
+     * @brief Interface between Draw and the thing that actually puts pixels on screen.
+     * @details Draw does all of its rendering through this, so the renderer can be swapped
+     * without touching Draw's callers. Backends own their textures and hand out TextureHandles.
+     * State (target, viewport, scale, draw color and blend mode) works like SDL_Renderer's:
+     * it stays set until changed, and the viewport and scale apply to all drawing.
+     */
+    class RenderBackend
+    {
+    public:
+        virtual ~RenderBackend() {}
+        virtual const char *name() const = 0;
+
+        //=== textures ===
+        /// Create an empty RGBA texture that can be used as a render target.
+        virtual TextureHandle createTexture(int w, int h) = 0;
+        virtual TextureHandle createTextureFromSurface(SDL_Surface *surface) = 0;
+        virtual void destroyTexture(TextureHandle texture) = 0;
+        virtual bool isValid(TextureHandle texture) const = 0;
+        virtual void queryTexture(TextureHandle texture, int *w, int *h) = 0;
+        virtual void setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode) = 0;
+
+        //=== state ===
+        /// Render into texture. A null handle renders to the screen.
+        virtual void setTarget(TextureHandle texture) = 0;
+        /// NULL resets the viewport to the whole target.
+        virtual void setViewport(const SDL_Rect *rect) = 0;
+        virtual void setScale(float scaleX, float scaleY) = 0;
+        virtual void setDrawColor(SDL_Color color) = 0;
+        virtual void setDrawBlendMode(SDL_BlendMode mode) = 0;
+
+        //=== drawing ===
+        /// Fill the whole target with the draw color, ignoring the viewport.
+        virtual void clear() = 0;
+        /// NULL fills the whole viewport.
+        virtual void fillRect(const SDL_Rect *rect) = 0;
+        virtual void drawLines(const SDL_Point *points, int count) = 0;
+        /// NULL src copies the whole texture, NULL dst fills the whole viewport.
+        virtual void copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                          double angle = 0.0, const SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE) = 0;
+        /// Draw many quads from one texture in a single batch. A null texture draws solid quads.
+        virtual void drawSprites(TextureHandle texture, const Sprite *sprites, int count) = 0;
+        virtual void present() = 0;
+        /// Read back the whole screen as drawn so far this frame.
+        virtual bool readPixels(Image &image) = 0;
+    };
+
+    /**
+     * @brief Create a render backend for window.
+     * @param window the window to present to. The CPU backend also works without one (headless).
+     * @param w,h framebuffer size, used by the CPU backend
+     */
+    std::unique_ptr<RenderBackend> createRenderBackend(RenderBackendType type, SDL_Window *window, int w, int h);
+
+} // namespace OWL
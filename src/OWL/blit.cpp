@@ -0,0 +1,266 @@
+#include "blit.h"
+#include <string.h>
+#include "simd.h"
+
+#if defined(OWL_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(OWL_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace OWL
+{
+    namespace blit
+    {
+        const char *simdLevel()
+        {
+            return simdLevelName();
+        }
+
+        //=== scalar =================================================================
+
+        // exact round(t / 255) for t in [0, 255 * 255]; the SIMD code does the same in 16-bit lanes
+        static inline uint32_t div255(uint32_t t)
+        {
+            t += 128;
+            return (t + (t >> 8)) >> 8;
+        }
+
+        static inline uint32_t blendPixel(uint32_t d, uint32_t s, SDL_BlendMode mode)
+        {
+            uint32_t a = s >> 24;
+            uint32_t out = 0;
+            switch (mode)
+            {
+            case SDL_BLENDMODE_BLEND:
+            {
+                // dstRGB = srcRGB * srcA + dstRGB * (1 - srcA), dstA = srcA + dstA * (1 - srcA)
+                // the alpha channel is the same formula with a source value of 255
+                s |= 0xFF000000;
+                for (int c = 0; c < 32; c += 8)
+                    out |= div255(((s >> c) & 0xFF) * a + ((d >> c) & 0xFF) * (255 - a)) << c;
+                return out;
+            }
+            case SDL_BLENDMODE_ADD:
+                for (int c = 0; c < 24; c += 8)
+                {
+                    uint32_t v = div255(((s >> c) & 0xFF) * a) + ((d >> c) & 0xFF);
+                    out |= (v > 255 ? 255 : v) << c;
+                }
+                return out | (d & 0xFF000000);
+            case SDL_BLENDMODE_MOD:
+                for (int c = 0; c < 24; c += 8)
+                    out |= div255(((s >> c) & 0xFF) * ((d >> c) & 0xFF)) << c;
+                return out | (d & 0xFF000000);
+            default:
+                return s;
+            }
+        }
+
+        static void blendSpanScalar(uint32_t *dst, const uint32_t *src, int n, SDL_BlendMode mode)
+        {
+            for (int i = 0; i < n; i++)
+                dst[i] = blendPixel(dst[i], src[i], mode);
+        }
+
+        static void fillSpanScalar(uint32_t *dst, uint32_t color, int n, SDL_BlendMode mode)
+        {
+            for (int i = 0; i < n; i++)
+                dst[i] = blendPixel(dst[i], color, mode);
+        }
+
+        void tintSpan(uint32_t *pixels, uint32_t color, int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                uint32_t p = pixels[i], out = 0;
+                for (int c = 0; c < 32; c += 8)
+                    out |= div255(((p >> c) & 0xFF) * ((color >> c) & 0xFF)) << c;
+                pixels[i] = out;
+            }
+        }
+
+        //=== SSE2 ===================================================================
+#ifdef OWL_SIMD_SSE2
+        // blend two pixels that have been widened to 16 bits per channel
+        static inline __m128i blendWide(__m128i s, __m128i d, __m128i a)
+        {
+            const __m128i c255 = _mm_set1_epi16(255);
+            const __m128i c128 = _mm_set1_epi16(128);
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_xor_si128(a, c255)));
+            t = _mm_add_epi16(t, c128);
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+
+        static inline __m128i blend4(__m128i s, __m128i d)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            __m128i sa = _mm_or_si128(s, alpha);
+            __m128i alo = _mm_unpacklo_epi8(s, zero);
+            __m128i ahi = _mm_unpackhi_epi8(s, zero);
+            alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(alo, 0xFF), 0xFF);
+            ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ahi, 0xFF), 0xFF);
+            __m128i lo = blendWide(_mm_unpacklo_epi8(sa, zero), _mm_unpacklo_epi8(d, zero), alo);
+            __m128i hi = blendWide(_mm_unpackhi_epi8(sa, zero), _mm_unpackhi_epi8(d, zero), ahi);
+            return _mm_packus_epi16(lo, hi);
+        }
+
+        static void blendSpanSSE2(uint32_t *dst, const uint32_t *src, int n, SDL_BlendMode mode)
+        {
+            if (mode == SDL_BLENDMODE_NONE)
+            {
+                memcpy(dst, src, n * sizeof(uint32_t));
+                return;
+            }
+            if (mode != SDL_BLENDMODE_BLEND)
+            {
+                blendSpanScalar(dst, src, n, mode);
+                return;
+            }
+            int i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+                _mm_storeu_si128((__m128i *)(dst + i), blend4(s, d));
+            }
+            blendSpanScalar(dst + i, src + i, n - i, mode);
+        }
+
+        static void fillSpanSSE2(uint32_t *dst, uint32_t color, int n, SDL_BlendMode mode)
+        {
+            __m128i s = _mm_set1_epi32((int)color);
+            int i = 0;
+            if (mode == SDL_BLENDMODE_NONE)
+            {
+                for (; i + 4 <= n; i += 4)
+                    _mm_storeu_si128((__m128i *)(dst + i), s);
+            }
+            else if (mode == SDL_BLENDMODE_BLEND)
+            {
+                for (; i + 4 <= n; i += 4)
+                {
+                    __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+                    _mm_storeu_si128((__m128i *)(dst + i), blend4(s, d));
+                }
+            }
+            fillSpanScalar(dst + i, color, n - i, mode);
+        }
+#endif
+
+        //=== AVX2 ===================================================================
+#ifdef OWL_SIMD_AVX2
+        __attribute__((target("avx2"))) static inline __m256i blendWide8(__m256i s, __m256i d, __m256i a)
+        {
+            const __m256i c255 = _mm256_set1_epi16(255);
+            const __m256i c128 = _mm256_set1_epi16(128);
+            __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, _mm256_xor_si256(a, c255)));
+            t = _mm256_add_epi16(t, c128);
+            return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        }
+
+        // same as blend4, on both 128-bit lanes at once
+        __attribute__((target("avx2"))) static inline __m256i blend8(__m256i s, __m256i d)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+            __m256i sa = _mm256_or_si256(s, alpha);
+            __m256i alo = _mm256_unpacklo_epi8(s, zero);
+            __m256i ahi = _mm256_unpackhi_epi8(s, zero);
+            alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(alo, 0xFF), 0xFF);
+            ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(ahi, 0xFF), 0xFF);
+            __m256i lo = blendWide8(_mm256_unpacklo_epi8(sa, zero), _mm256_unpacklo_epi8(d, zero), alo);
+            __m256i hi = blendWide8(_mm256_unpackhi_epi8(sa, zero), _mm256_unpackhi_epi8(d, zero), ahi);
+            return _mm256_packus_epi16(lo, hi);
+        }
+
+        __attribute__((target("avx2"))) static void blendSpanAVX2(uint32_t *dst, const uint32_t *src, int n, SDL_BlendMode mode)
+        {
+            if (mode == SDL_BLENDMODE_NONE)
+            {
+                memcpy(dst, src, n * sizeof(uint32_t));
+                return;
+            }
+            if (mode != SDL_BLENDMODE_BLEND)
+            {
+                blendSpanScalar(dst, src, n, mode);
+                return;
+            }
+            int i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+                __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+                _mm256_storeu_si256((__m256i *)(dst + i), blend8(s, d));
+            }
+            blendSpanScalar(dst + i, src + i, n - i, mode);
+        }
+
+        __attribute__((target("avx2"))) static void fillSpanAVX2(uint32_t *dst, uint32_t color, int n, SDL_BlendMode mode)
+        {
+            __m256i s = _mm256_set1_epi32((int)color);
+            int i = 0;
+            if (mode == SDL_BLENDMODE_NONE)
+            {
+                for (; i + 8 <= n; i += 8)
+                    _mm256_storeu_si256((__m256i *)(dst + i), s);
+            }
+            else if (mode == SDL_BLENDMODE_BLEND)
+            {
+                for (; i + 8 <= n; i += 8)
+                {
+                    __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+                    _mm256_storeu_si256((__m256i *)(dst + i), blend8(s, d));
+                }
+            }
+            fillSpanScalar(dst + i, color, n - i, mode);
+        }
+#endif
+
+        //=== dispatch ===============================================================
+
+        void blendSpan(uint32_t *dst, const uint32_t *src, int n, SDL_BlendMode mode)
+        {
+            if (n <= 0)
+                return;
+            switch (OWL::simdLevel())
+            {
+#ifdef OWL_SIMD_AVX2
+            case SimdLevel::AVX2:
+                blendSpanAVX2(dst, src, n, mode);
+                return;
+#endif
+#ifdef OWL_SIMD_SSE2
+            case SimdLevel::SSE2:
+                blendSpanSSE2(dst, src, n, mode);
+                return;
+#endif
+            default:
+                blendSpanScalar(dst, src, n, mode);
+            }
+        }
+
+        void fillSpan(uint32_t *dst, uint32_t color, int n, SDL_BlendMode mode)
+        {
+            if (n <= 0)
+                return;
+            switch (OWL::simdLevel())
+            {
+#ifdef OWL_SIMD_AVX2
+            case SimdLevel::AVX2:
+                fillSpanAVX2(dst, color, n, mode);
+                return;
+#endif
+#ifdef OWL_SIMD_SSE2
+            case SimdLevel::SSE2:
+                fillSpanSSE2(dst, color, n, mode);
+                return;
+#endif
+            default:
+                fillSpanScalar(dst, color, n, mode);
+            }
+        }
+    } // namespace blit
+} // namespace OWL
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+namespace OWL
+{
+    /**
+     * @brief Pixel span kernels for the CPU render backend.
+     * @details Pixels are 32-bit RGBA, byte order R,G,B,A in memory (SDL_PIXELFORMAT_RGBA32),
+     * with straight (not premultiplied) alpha. Blend modes follow SDL's definitions.
+     * Every kernel exists as scalar, SSE2 and AVX2 code that use the same integer math,
+     * so they give bit-identical results. Which one runs is decided by simdLevel() in simd.h.
+     */
+    namespace blit
+    {
+        /// Blend n pixels of src onto dst.
+        void blendSpan(uint32_t *dst, const uint32_t *src, int n, SDL_BlendMode mode);
+        /// Blend a single color onto n pixels of dst.
+        void fillSpan(uint32_t *dst, uint32_t color, int n, SDL_BlendMode mode);
+        /// Multiply n pixels channel by channel with color, like SDL's texture color and alpha mod.
+        void tintSpan(uint32_t *pixels, uint32_t color, int n);
+        /// Name of the kernel set in use: "scalar", "sse2" or "avx2".
+        const char *simdLevel();
+
+        inline uint32_t packColor(SDL_Color c)
+        {
+            return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | ((uint32_t)c.a << 24);
+        }
+    } // namespace blit
+
+} // namespace OWL
@@ -0,0 +1,81 @@
+#include "capture.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace OWL
+{
+    bool savePNG(const Image &image, const std::string &path)
+    {
+        SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)image.pixels.data(), image.w, image.h, 32,
+                                                                  image.w * sizeof(uint32_t), SDL_PIXELFORMAT_RGBA32);
+        if (surface == nullptr)
+        {
+            printf("Unable to create capture surface! SDL_Error: %s\n", SDL_GetError());
+            return false;
+        }
+        bool saved = IMG_SavePNG(surface, path.c_str()) == 0;
+        if (!saved)
+            printf("Unable to save %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+        SDL_FreeSurface(surface);
+        return saved;
+    }
+
+    bool loadPNG(const std::string &path, Image &image)
+    {
+        SDL_Surface *loaded = IMG_Load(path.c_str());
+        if (loaded == nullptr)
+            return false;
+        SDL_Surface *rgba = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(loaded);
+        if (rgba == nullptr)
+            return false;
+        image.w = rgba->w;
+        image.h = rgba->h;
+        image.pixels.resize((size_t)image.w * image.h);
+        SDL_LockSurface(rgba);
+        for (int y = 0; y < image.h; y++)
+            memcpy(&image.pixels[(size_t)y * image.w], static_cast<uint8_t *>(rgba->pixels) + (size_t)y * rgba->pitch,
+                   image.w * sizeof(uint32_t));
+        SDL_UnlockSurface(rgba);
+        SDL_FreeSurface(rgba);
+        return true;
+    }
+
+    ImageDiff compareImages(const Image &a, const Image &b, int tolerance, Image *diffImage)
+    {
+        ImageDiff diff;
+        if (a.w != b.w || a.h != b.h)
+        {
+            diff.sizeMismatch = true;
+            return diff;
+        }
+        if (diffImage != nullptr)
+            *diffImage = a;
+        for (size_t i = 0; i < a.pixels.size(); i++)
+        {
+            uint32_t pa = a.pixels[i], pb = b.pixels[i];
+            if (pa == pb)
+                continue;
+            int delta = 0;
+            for (int c = 0; c < 32; c += 8)
+            {
+                int d = abs((int)((pa >> c) & 0xFF) - (int)((pb >> c) & 0xFF));
+                if (d > delta)
+                    delta = d;
+            }
+            if (delta > diff.maxChannelDelta)
+                diff.maxChannelDelta = delta;
+            if (delta > tolerance)
+            {
+                diff.differentPixels++;
+                if (diffImage != nullptr)
+                    diffImage->pixels[i] = 0xFFFF00FF;
+            }
+        }
+        return diff;
+    }
+
+} // namespace OWL
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace OWL
+{
+    /// RGBA32 image, byte order R,G,B,A in memory, tightly packed rows.
+    struct Image
+    {
+        int w{0}, h{0};
+        std::vector<uint32_t> pixels;
+    };
+
+    /**
+     * @brief Result of comparing two images.
+     * @param differentPixels pixels where some channel differs by more than the tolerance
+     * @param maxChannelDelta largest difference of any channel
+     * @param sizeMismatch the images are not the same size, nothing else is filled in
+     */
+    struct ImageDiff
+    {
+        int differentPixels{0};
+        int maxChannelDelta{0};
+        bool sizeMismatch{false};
+    };
+
+    bool savePNG(const Image &image, const std::string &path);
+    bool loadPNG(const std::string &path, Image &image);
+
+    /**
+     * @brief Compare a and b channel by channel.
+     * @param tolerance channel difference that still counts as equal
+     * @param diffImage if given, gets a copy of a with the differing pixels painted magenta
+     */
+    ImageDiff compareImages(const Image &a, const Image &b, int tolerance, Image *diffImage = nullptr);
+
+} // namespace OWL
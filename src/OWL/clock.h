@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+namespace OWL
+{
+    /**
+     * @brief The game's tick clock, in milliseconds.
+     * @details By default it follows SDL_GetTicks(). Headless runs switch it to manual mode,
+     * where time only moves with advanceTicks(), so everything stamped with it is deterministic.
+     */
+    struct TickClock
+    {
+        bool manual{false};
+        uint32_t now{0};
+    };
+
+    inline TickClock &tickClock()
+    {
+        static TickClock clock;
+        return clock;
+    }
+
+    inline uint32_t ticks()
+    {
+        TickClock &clock = tickClock();
+        return clock.manual ? clock.now : SDL_GetTicks();
+    }
+
+    /// Stop following SDL_GetTicks() and start counting from start.
+    inline void setManualClock(uint32_t start = 0)
+    {
+        tickClock().manual = true;
+        tickClock().now = start;
+    }
+
+    inline void advanceTicks(uint32_t ms)
+    {
+        tickClock().now += ms;
+    }
+
+} // namespace OWL
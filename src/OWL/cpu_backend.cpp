@@ -0,0 +1,570 @@
+#include "cpu_backend.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "alloc.h"
+#include "blit.h"
+
+namespace OWL
+{
+    static const int tileHeight = 16;          // rows per rasterizer tile
+    static const int parallelMinPixels = 16384; // smaller targets are rasterized on the calling thread
+
+    static SDL_Rect intersect(const SDL_Rect &a, const SDL_Rect &b)
+    {
+        int x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+        int x1 = std::min(a.x + a.w, b.x + b.w), y1 = std::min(a.y + a.h, b.y + b.h);
+        return {x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+    }
+
+    //=== CpuTexture ===============================================================
+
+    CpuTexture::CpuTexture(int w, int h)
+        : w{std::max(1, w)}, h{std::max(1, h)}, pitch{(std::max(1, w) + 15) & ~15}
+    {
+        size_t bytes = (size_t)pitch * this->h * sizeof(uint32_t);
+        pixels = static_cast<uint32_t *>(alignedAlloc(bytes, 64));
+        if (pixels != nullptr)
+            memset(pixels, 0, bytes);
+    }
+
+    CpuTexture::~CpuTexture()
+    {
+        alignedFree(pixels);
+    }
+
+    //=== TileWorkers ==============================================================
+
+    TileWorkers::TileWorkers(int count)
+    {
+        if (count <= 0)
+            count = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 1; i < count; i++)
+            threads.emplace_back(&TileWorkers::work, this);
+    }
+
+    TileWorkers::~TileWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void TileWorkers::run(int count, const std::function<void(int)> &j)
+    {
+        if (threads.empty() || count <= 1)
+        {
+            for (int i = 0; i < count; i++)
+                j(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &j;
+            jobCount = count;
+            nextJob = 0;
+            active = (int)threads.size();
+            generation++;
+        }
+        wake.notify_all();
+        runJobs();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active == 0; });
+    }
+
+    void TileWorkers::runJobs()
+    {
+        for (int i = nextJob.fetch_add(1); i < jobCount; i = nextJob.fetch_add(1))
+            (*job)(i);
+    }
+
+    void TileWorkers::work()
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+            runJobs();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+                done.notify_one();
+        }
+    }
+
+    //=== CpuBackend ===============================================================
+
+    CpuBackend::CpuBackend(SDL_Window *window, int w, int h, int threads)
+        : window{window}, screen{w, h}, workers{threads}, target{&screen},
+          viewport{0, 0, screen.w, screen.h}, screenViewport{viewport}
+    {
+        if (!screen.isValid())
+            printf("Unable to allocate %dx%d CPU framebuffer!\n", screen.w, screen.h);
+        printf("CPU renderer: %dx%d, %d threads, %s blitter\n", screen.w, screen.h, workers.size(), blit::simdLevel());
+    }
+
+    TextureHandle CpuBackend::addTexture(CpuTexture *texture)
+    {
+        if (!texture->isValid())
+        {
+            printf("Unable to allocate %dx%d CPU texture!\n", texture->w, texture->h);
+            delete texture;
+            return TextureHandle();
+        }
+        return textures.add(texture);
+    }
+
+    TextureHandle CpuBackend::createTexture(int w, int h)
+    {
+        return addTexture(new CpuTexture(w, h));
+    }
+
+    TextureHandle CpuBackend::createTextureFromSurface(SDL_Surface *surface)
+    {
+        if (surface == nullptr)
+            return TextureHandle();
+        // converting also turns a color key into transparent pixels
+        SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        if (rgba == nullptr)
+        {
+            printf("Unable to convert surface! SDL_Error: %s\n", SDL_GetError());
+            return TextureHandle();
+        }
+        CpuTexture *texture = new CpuTexture(rgba->w, rgba->h);
+        if (!texture->isValid())
+        {
+            SDL_FreeSurface(rgba);
+            return addTexture(texture); // reports and deletes it
+        }
+        SDL_LockSurface(rgba);
+        for (int y = 0; y < rgba->h; y++)
+            memcpy(texture->row(y), static_cast<uint8_t *>(rgba->pixels) + (size_t)y * rgba->pitch, rgba->w * sizeof(uint32_t));
+        SDL_UnlockSurface(rgba);
+        SDL_FreeSurface(rgba);
+        texture->blendMode = SDL_BLENDMODE_BLEND;
+        return addTexture(texture);
+    }
+
+    void CpuBackend::destroyTexture(TextureHandle texture)
+    {
+        CpuTexture *t = textures.get(texture);
+        if (t == nullptr)
+            return;
+        // pending commands may still read from it
+        if (t == target)
+            setTarget(TextureHandle());
+        flush();
+        textures.release(texture);
+    }
+
+    void CpuBackend::queryTexture(TextureHandle texture, int *w, int *h)
+    {
+        CpuTexture *t = textures.get(texture);
+        if (w != nullptr)
+            *w = t ? t->w : 0;
+        if (h != nullptr)
+            *h = t ? t->h : 0;
+    }
+
+    void CpuBackend::setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode)
+    {
+        // commands keep the blend mode they were recorded with, so no flush is needed
+        CpuTexture *t = textures.get(texture);
+        if (t != nullptr)
+            t->blendMode = mode;
+    }
+
+    void CpuBackend::setTarget(TextureHandle texture)
+    {
+        CpuTexture *t = textures.get(texture);
+        if (t == nullptr)
+            t = &screen;
+        if (t == target)
+            return;
+        flush();
+        // like SDL_Renderer, the screen keeps its viewport and scale while a texture is the target
+        if (target == &screen)
+        {
+            screenViewport = viewport;
+            screenScaleX = scaleX;
+            screenScaleY = scaleY;
+        }
+        target = t;
+        if (target == &screen)
+        {
+            viewport = screenViewport;
+            scaleX = screenScaleX;
+            scaleY = screenScaleY;
+        }
+        else
+        {
+            viewport = {0, 0, target->w, target->h};
+            scaleX = scaleY = 1.0f;
+        }
+    }
+
+    void CpuBackend::setViewport(const SDL_Rect *rect)
+    {
+        if (rect == nullptr)
+            viewport = {0, 0, target->w, target->h};
+        else
+            viewport = {(int)floorf(rect->x * scaleX), (int)floorf(rect->y * scaleY),
+                        (int)ceilf(rect->w * scaleX), (int)ceilf(rect->h * scaleY)};
+    }
+
+    void CpuBackend::setScale(float sx, float sy)
+    {
+        scaleX = sx;
+        scaleY = sy;
+    }
+
+    void CpuBackend::setDrawColor(SDL_Color color)
+    {
+        drawColor = blit::packColor(color);
+    }
+
+    void CpuBackend::setDrawBlendMode(SDL_BlendMode mode)
+    {
+        drawBlend = mode;
+    }
+
+    /// Map a rect in viewport coordinates to target pixels.
+    SDL_Rect CpuBackend::toTarget(const SDL_Rect &r) const
+    {
+        int x0 = viewport.x + (int)floorf(r.x * scaleX);
+        int y0 = viewport.y + (int)floorf(r.y * scaleY);
+        int x1 = viewport.x + (int)floorf((r.x + r.w) * scaleX);
+        int y1 = viewport.y + (int)floorf((r.y + r.h) * scaleY);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    SDL_Rect CpuBackend::toTarget(const SDL_FRect &r) const
+    {
+        int x0 = viewport.x + (int)floorf(r.x * scaleX);
+        int y0 = viewport.y + (int)floorf(r.y * scaleY);
+        int x1 = viewport.x + (int)floorf((r.x + r.w) * scaleX);
+        int y1 = viewport.y + (int)floorf((r.y + r.h) * scaleY);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    SDL_Rect CpuBackend::clipRect() const
+    {
+        return intersect(viewport, {0, 0, target->w, target->h});
+    }
+
+    void CpuBackend::pushFill(const SDL_Rect &dst, const SDL_Rect &clip, uint32_t color, SDL_BlendMode mode)
+    {
+        Command c{};
+        c.type = Command::FILL;
+        c.dst = dst;
+        c.clip = clip;
+        c.color = color;
+        c.blend = mode;
+        commands.push_back(c);
+    }
+
+    void CpuBackend::clear()
+    {
+        SDL_Rect all = {0, 0, target->w, target->h};
+        pushFill(all, all, drawColor, SDL_BLENDMODE_NONE);
+    }
+
+    void CpuBackend::fillRect(const SDL_Rect *rect)
+    {
+        pushFill(rect ? toTarget(*rect) : viewport, clipRect(), drawColor, drawBlend);
+    }
+
+    void CpuBackend::drawLines(const SDL_Point *points, int count)
+    {
+        SDL_Rect clip = clipRect();
+        if (count == 1)
+            pushFill(toTarget(SDL_Rect{points[0].x, points[0].y, 1, 1}), clip, drawColor, drawBlend);
+        for (int i = 0; i + 1 < count; i++)
+        {
+            SDL_Point a = points[i], b = points[i + 1];
+            if (a.x == b.x || a.y == b.y)
+            {
+                // axis aligned, one rect for the whole segment
+                SDL_Rect r = {std::min(a.x, b.x), std::min(a.y, b.y), abs(b.x - a.x) + 1, abs(b.y - a.y) + 1};
+                pushFill(toTarget(r), clip, drawColor, drawBlend);
+                continue;
+            }
+            // Bresenham, one logical pixel at a time
+            int dx = abs(b.x - a.x), sx = a.x < b.x ? 1 : -1;
+            int dy = -abs(b.y - a.y), sy = a.y < b.y ? 1 : -1;
+            int err = dx + dy;
+            while (true)
+            {
+                pushFill(toTarget(SDL_Rect{a.x, a.y, 1, 1}), clip, drawColor, drawBlend);
+                if (a.x == b.x && a.y == b.y)
+                    break;
+                int e2 = 2 * err;
+                if (e2 >= dy)
+                {
+                    err += dy;
+                    a.x += sx;
+                }
+                if (e2 <= dx)
+                {
+                    err += dx;
+                    a.y += sy;
+                }
+            }
+        }
+    }
+
+    void CpuBackend::copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                          double angle, const SDL_Point *center, SDL_RendererFlip flip)
+    {
+        const CpuTexture *t = textures.get(texture);
+        if (t == nullptr)
+            return;
+        Command c{};
+        c.type = Command::COPY;
+        c.texture = t;
+        c.tint = 0xFFFFFFFF;
+        c.src = intersect(src ? *src : SDL_Rect{0, 0, t->w, t->h}, {0, 0, t->w, t->h});
+        c.dst = dst ? toTarget(*dst) : viewport;
+        c.clip = clipRect();
+        c.blend = t->blendMode;
+        c.flip = flip;
+        c.angle = fmod(angle, 360.0);
+        c.centerX = center ? c.dst.x + center->x * scaleX : c.dst.x + c.dst.w / 2.0;
+        c.centerY = center ? c.dst.y + center->y * scaleY : c.dst.y + c.dst.h / 2.0;
+        if (c.src.w <= 0 || c.src.h <= 0 || c.dst.w <= 0 || c.dst.h <= 0)
+            return;
+        commands.push_back(c);
+    }
+
+    void CpuBackend::drawSprites(TextureHandle texture, const Sprite *sprites, int count)
+    {
+        const CpuTexture *t = textures.get(texture);
+        SDL_Rect clip = clipRect();
+        SDL_Rect bounds = t ? SDL_Rect{0, 0, t->w, t->h} : SDL_Rect{0, 0, 0, 0};
+        commands.reserve(commands.size() + count);
+        for (int i = 0; i < count; i++)
+        {
+            const Sprite &s = sprites[i];
+            SDL_Rect dst = toTarget(s.dst);
+            if (dst.w <= 0 || dst.h <= 0)
+                continue;
+            if (t == nullptr)
+            {
+                pushFill(dst, clip, blit::packColor(s.color), SDL_BLENDMODE_BLEND);
+                continue;
+            }
+            Command c{};
+            c.type = Command::COPY;
+            c.texture = t;
+            c.tint = blit::packColor(s.color);
+            c.src = s.src.w > 0 ? intersect(s.src, bounds) : bounds;
+            c.dst = dst;
+            c.clip = clip;
+            c.blend = t->blendMode;
+            c.flip = SDL_FLIP_NONE;
+            if (c.src.w > 0 && c.src.h > 0)
+                commands.push_back(c);
+        }
+    }
+
+    void CpuBackend::flush()
+    {
+        if (commands.empty())
+            return;
+        CpuTexture *t = target;
+        int tiles = (t->h + tileHeight - 1) / tileHeight;
+
+        // bin every command to the tiles it can touch, keeping recording order
+        if ((int)tileCommands.size() < tiles)
+            tileCommands.resize(tiles);
+        for (int i = 0; i < tiles; i++)
+            tileCommands[i].clear();
+        for (uint32_t i = 0; i < commands.size(); i++)
+        {
+            const Command &c = commands[i];
+            // rotated copies can reach anywhere inside their clip rect
+            SDL_Rect r = c.type == Command::COPY && c.angle != 0.0 ? c.clip : intersect(c.dst, c.clip);
+            if (r.w <= 0 || r.h <= 0)
+                continue;
+            for (int tile = r.y / tileHeight; tile <= (r.y + r.h - 1) / tileHeight; tile++)
+                tileCommands[tile].push_back(i);
+        }
+
+        auto job = [this, t](int tile) {
+            int y0 = tile * tileHeight;
+            int y1 = std::min(t->h, y0 + tileHeight);
+            for (uint32_t i : tileCommands[tile])
+                rasterize(commands[i], y0, y1);
+        };
+        if (t->w * t->h < parallelMinPixels)
+        {
+            for (int i = 0; i < tiles; i++)
+                job(i);
+        }
+        else
+            workers.run(tiles, job);
+        commands.clear();
+    }
+
+    void CpuBackend::rasterize(const Command &c, int y0, int y1)
+    {
+        SDL_Rect band = {0, y0, target->w, y1 - y0};
+        SDL_Rect clip = intersect(c.clip, band);
+
+        if (c.type == Command::FILL)
+        {
+            SDL_Rect r = intersect(c.dst, clip);
+            for (int y = r.y; y < r.y + r.h; y++)
+                blit::fillSpan(target->row(y) + r.x, c.color, r.w, c.blend);
+            return;
+        }
+
+        if (c.angle != 0.0)
+        {
+            rasterizeRotated(c, clip);
+            return;
+        }
+
+        SDL_Rect r = intersect(c.dst, clip);
+        if (r.w <= 0 || r.h <= 0)
+            return;
+
+        // source column for every destination column, sampled at pixel centers
+        static thread_local std::vector<int> columns;
+        static thread_local std::vector<uint32_t> span;
+        bool tinted = c.tint != 0xFFFFFFFF;
+        bool direct = c.src.w == c.dst.w && !(c.flip & SDL_FLIP_HORIZONTAL) && !tinted;
+        if (!direct)
+        {
+            columns.resize(r.w);
+            span.resize(r.w);
+            for (int i = 0; i < r.w; i++)
+            {
+                int64_t dx = r.x + i - c.dst.x;
+                if (c.flip & SDL_FLIP_HORIZONTAL)
+                    dx = c.dst.w - 1 - dx;
+                columns[i] = c.src.x + (int)(((2 * dx + 1) * c.src.w) / (2 * (int64_t)c.dst.w));
+            }
+        }
+
+        for (int y = r.y; y < r.y + r.h; y++)
+        {
+            int64_t dy = y - c.dst.y;
+            if (c.flip & SDL_FLIP_VERTICAL)
+                dy = c.dst.h - 1 - dy;
+            int sy = c.src.y + (int)(((2 * dy + 1) * c.src.h) / (2 * (int64_t)c.dst.h));
+            const uint32_t *srow = c.texture->row(sy);
+            uint32_t *drow = target->row(y) + r.x;
+            if (direct)
+                blit::blendSpan(drow, srow + c.src.x + (r.x - c.dst.x), r.w, c.blend);
+            else
+            {
+                for (int i = 0; i < r.w; i++)
+                    span[i] = srow[columns[i]];
+                if (tinted)
+                    blit::tintSpan(span.data(), c.tint, r.w);
+                blit::blendSpan(drow, span.data(), r.w, c.blend);
+            }
+        }
+    }
+
+    void CpuBackend::rasterizeRotated(const Command &c, const SDL_Rect &clip)
+    {
+        // positive angles turn clockwise, like SDL_RenderCopyEx
+        double rad = c.angle * M_PI / 180.0;
+        double cosA = cos(rad), sinA = sin(rad);
+
+        double xs[4] = {(double)c.dst.x, (double)c.dst.x + c.dst.w, (double)c.dst.x, (double)c.dst.x + c.dst.w};
+        double ys[4] = {(double)c.dst.y, (double)c.dst.y, (double)c.dst.y + c.dst.h, (double)c.dst.y + c.dst.h};
+        double minX = 1e9, minY = 1e9, maxX = -1e9, maxY = -1e9;
+        for (int i = 0; i < 4; i++)
+        {
+            double dx = xs[i] - c.centerX, dy = ys[i] - c.centerY;
+            double rx = c.centerX + dx * cosA - dy * sinA;
+            double ry = c.centerY + dx * sinA + dy * cosA;
+            minX = std::min(minX, rx), maxX = std::max(maxX, rx);
+            minY = std::min(minY, ry), maxY = std::max(maxY, ry);
+        }
+        SDL_Rect bounds = {(int)floor(minX), (int)floor(minY), 0, 0};
+        bounds.w = (int)ceil(maxX) - bounds.x;
+        bounds.h = (int)ceil(maxY) - bounds.y;
+        SDL_Rect r = intersect(bounds, clip);
+
+        static thread_local std::vector<uint32_t> span;
+        span.resize(std::max(0, r.w));
+        for (int y = r.y; y < r.y + r.h; y++)
+        {
+            // the rotated rect is convex, so the covered pixels of a row are one run
+            int first = -1, last = -1;
+            for (int i = 0; i < r.w; i++)
+            {
+                double dx = r.x + i + 0.5 - c.centerX, dy = y + 0.5 - c.centerY;
+                int lx = (int)floor(c.centerX + dx * cosA + dy * sinA) - c.dst.x;
+                int ly = (int)floor(c.centerY - dx * sinA + dy * cosA) - c.dst.y;
+                if (lx < 0 || ly < 0 || lx >= c.dst.w || ly >= c.dst.h)
+                {
+                    if (first >= 0)
+                        break;
+                    continue;
+                }
+                if (c.flip & SDL_FLIP_HORIZONTAL)
+                    lx = c.dst.w - 1 - lx;
+                if (c.flip & SDL_FLIP_VERTICAL)
+                    ly = c.dst.h - 1 - ly;
+                int sx = c.src.x + (int)(((2 * (int64_t)lx + 1) * c.src.w) / (2 * (int64_t)c.dst.w));
+                int sy = c.src.y + (int)(((2 * (int64_t)ly + 1) * c.src.h) / (2 * (int64_t)c.dst.h));
+                if (first < 0)
+                    first = i;
+                last = i;
+                span[i] = c.texture->row(sy)[sx];
+            }
+            if (first < 0)
+                continue;
+            if (c.tint != 0xFFFFFFFF)
+                blit::tintSpan(span.data() + first, c.tint, last - first + 1);
+            blit::blendSpan(target->row(y) + r.x + first, span.data() + first, last - first + 1, c.blend);
+        }
+    }
+
+    void CpuBackend::present()
+    {
+        flush();
+        if (window == nullptr)
+            return;
+        SDL_Surface *surface = SDL_GetWindowSurface(window);
+        if (surface == nullptr)
+            return;
+        SDL_ConvertPixels(std::min(screen.w, surface->w), std::min(screen.h, surface->h),
+                          SDL_PIXELFORMAT_RGBA32, screen.pixels, screen.pitch * sizeof(uint32_t),
+                          surface->format->format, surface->pixels, surface->pitch);
+        SDL_UpdateWindowSurface(window);
+    }
+
+    bool CpuBackend::readPixels(Image &image)
+    {
+        flush();
+        image.w = screen.w;
+        image.h = screen.h;
+        image.pixels.resize((size_t)screen.w * screen.h);
+        for (int y = 0; y < screen.h; y++)
+            memcpy(&image.pixels[(size_t)y * screen.w], screen.row(y), screen.w * sizeof(uint32_t));
+        return true;
+    }
+
+    const CpuTexture &CpuBackend::framebuffer()
+    {
+        flush();
+        return screen;
+    }
+
+} // namespace OWL
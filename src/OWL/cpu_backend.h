@@ -0,0 +1,163 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "backend.h"
+#include "pool.h"
+
+namespace OWL
+{
+    /**
+     * @brief RGBA32 pixel buffer used for CPU textures and the CPU framebuffer.
+     * @details Rows start on 64-byte boundaries, pitch is in pixels.
+     * If the pixels can't be allocated, pixels is NULL; check isValid().
+     */
+    struct CpuTexture
+    {
+        CpuTexture(int w, int h);
+        ~CpuTexture();
+        CpuTexture(const CpuTexture &) = delete;
+        CpuTexture &operator=(const CpuTexture &) = delete;
+
+        bool isValid() const { return pixels != nullptr; }
+
+        uint32_t *row(int y) { return pixels + (size_t)y * pitch; }
+        const uint32_t *row(int y) const { return pixels + (size_t)y * pitch; }
+
+        int w, h;
+        int pitch;
+        uint32_t *pixels;
+        SDL_BlendMode blendMode{SDL_BLENDMODE_NONE};
+    };
+
+    /**
+     * @brief Small persistent thread pool for running the same job over many tiles.
+     * @param threads total number of threads to use, including the calling one. 0 means one per core.
+     */
+    class TileWorkers
+    {
+    public:
+        TileWorkers(int threads = 0);
+        ~TileWorkers();
+
+        /// Run job(0) ... job(count - 1) spread over all threads. Returns when every job is done.
+        void run(int count, const std::function<void(int)> &job);
+        int size() const { return (int)threads.size() + 1; }
+
+    private:
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(int)> *job{nullptr};
+        int jobCount{0};
+        std::atomic<int> nextJob{0};
+        int active{0};
+        uint64_t generation{0};
+        bool quit{false};
+
+        void work();
+        void runJobs();
+    };
+
+    /**
+     * @brief Pure CPU RenderBackend, for machines without a GPU and for deterministic output.
+     * @details Drawing calls are recorded as commands and rasterized when the target changes,
+     * a texture is destroyed or the frame is presented. The target is split into horizontal
+     * tiles that are rasterized in parallel. Commands are binned to the tiles they touch, and
+     * every tile runs its commands in recording order, so the result doesn't depend on the
+     * number of threads. Spans are blended with the SIMD kernels
+     * in blit.h. Scaled copies use nearest-neighbour sampling with integer math only, so output
+     * is bit-exact between runs, machines and SIMD levels.
+     *
+     * @param window window to present to with SDL_UpdateWindowSurface, or NULL to run headless
+     * @param w,h framebuffer size
+     * @param threads rasterizer threads, 0 means one per core
+     */
+    class CpuBackend : public RenderBackend
+    {
+    public:
+        CpuBackend(SDL_Window *window, int w, int h, int threads = 0);
+
+        const char *name() const { return "cpu"; }
+
+        TextureHandle createTexture(int w, int h);
+        TextureHandle createTextureFromSurface(SDL_Surface *surface);
+        void destroyTexture(TextureHandle texture);
+        bool isValid(TextureHandle texture) const { return textures.isValid(texture); }
+        void queryTexture(TextureHandle texture, int *w, int *h);
+        void setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode);
+
+        void setTarget(TextureHandle texture);
+        void setViewport(const SDL_Rect *rect);
+        void setScale(float scaleX, float scaleY);
+        void setDrawColor(SDL_Color color);
+        void setDrawBlendMode(SDL_BlendMode mode);
+
+        void clear();
+        void fillRect(const SDL_Rect *rect);
+        void drawLines(const SDL_Point *points, int count);
+        void copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                  double angle = 0.0, const SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
+        void drawSprites(TextureHandle texture, const Sprite *sprites, int count);
+        void present();
+        bool readPixels(Image &image);
+
+        /// The screen framebuffer, with all drawing so far rasterized into it.
+        const CpuTexture &framebuffer();
+        int threadCount() const { return workers.size(); }
+
+    private:
+        struct Command
+        {
+            enum Type
+            {
+                FILL,
+                COPY
+            } type;
+            SDL_Rect dst;  // target pixels
+            SDL_Rect clip; // viewport clipped to the target
+            SDL_BlendMode blend;
+            uint32_t color; // FILL
+            const CpuTexture *texture; // COPY
+            uint32_t tint;             // COPY, multiplied with the texture, 0xFFFFFFFF for none
+            SDL_Rect src;
+            SDL_RendererFlip flip;
+            double angle;
+            double centerX, centerY; // rotation center in target pixels
+        };
+
+        SDL_Window *window;
+        CpuTexture screen;
+        ResourcePool<CpuTexture, SDL_Texture, std::default_delete<CpuTexture>> textures;
+        TileWorkers workers;
+        std::vector<Command> commands;
+        std::vector<std::vector<uint32_t>> tileCommands; // indices of the commands touching each tile
+
+        CpuTexture *target;
+        SDL_Rect viewport; // in target pixels
+        float scaleX{1.0f}, scaleY{1.0f};
+        SDL_Rect screenViewport; // screen state, saved while rendering to a texture
+        float screenScaleX{1.0f}, screenScaleY{1.0f};
+        uint32_t drawColor{0xFF000000};
+        SDL_BlendMode drawBlend{SDL_BLENDMODE_NONE};
+
+        /// A new texture in the pool, or a null handle if its pixels can't be allocated.
+        TextureHandle addTexture(CpuTexture *texture);
+        SDL_Rect toTarget(const SDL_Rect &rect) const;
+        SDL_Rect toTarget(const SDL_FRect &rect) const;
+        SDL_Rect clipRect() const;
+        void pushFill(const SDL_Rect &dst, const SDL_Rect &clip, uint32_t color, SDL_BlendMode mode);
+        void flush();
+        void rasterize(const Command &command, int y0, int y1);
+        void rasterizeRotated(const Command &command, const SDL_Rect &bounds);
+    };
+
+} // namespace OWL
@@ -1,23 +1,33 @@
 #include "draw.h"
+#include <stdlib.h>
+#include <string.h>
 #include "globals.h"
 #include "msg.h"
 
 namespace OWL
 {
+    static bool stateCacheEnabled()
+    {
+        const char *setting = getenv("OWL_STATE_CACHE");
+        return setting == nullptr || strcmp(setting, "off") != 0;
+    }
+
+    Draw::Draw(const std::shared_ptr<MessageBus> msgBus, SDL_Window *window, RenderBackendType backendType)
+        : Draw(msgBus, createRenderBackend(backendType, window, SCREEN_WIDTH, SCREEN_HEIGHT)) {}
 
-    Draw::Draw(const std::shared_ptr<MessageBus> msgBus, SDL_Window *window)
+    Draw::Draw(const std::shared_ptr<MessageBus> msgBus, std::unique_ptr<RenderBackend> renderBackend)
         : BusNode(msgBus, "Draw"), font{TTF_OpenFont(defaultFont, 120)}, width{0}, height{0},
-          renderer{sdl_shared(SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC))}
+          backend{new StateCacheBackend(std::move(renderBackend), stateCacheEnabled())}
     {
         //font = TTF_OpenFont("OWL/hack-regular.ttf", 120);
         // font = TTF_OpenFont(defaultFont, 120);
         // width = 0;
         // height = 0;
-        // renderer = sdl_shared(SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC));
         int imgFlags = IMG_INIT_PNG;
+        send({std::string("Draw backend: ") + backend->name()});
     };
 
-    void Draw::render(std::shared_ptr<SDL_Texture> texture, int x, int y, int width, int height, SDL_Rect *clip, double angle, SDL_Point *center, SDL_RendererFlip flip)
+    void Draw::render(TextureHandle texture, int x, int y, int width, int height, SDL_Rect *clip, double angle, SDL_Point *center, SDL_RendererFlip flip)
     {
         //Set rendering space and render to screen
         SDL_Rect renderQuad = {x, y, width, height};
@@ -30,57 +40,111 @@ namespace OWL
         }
 
         //Render to screen
-        SDL_RenderCopyEx(renderer.get(), texture.get(), clip, &renderQuad, angle, center, flip);
+        backend->copy(texture, clip, &renderQuad, angle, center, flip);
     }
 
-    std::shared_ptr<SDL_Texture> Draw::createTextureFromSurface(std::shared_ptr<SDL_Surface> surface)
+    TextureHandle Draw::createTextureFromSurface(SurfaceHandle surface)
     {
-        auto texture = sdl_shared(SDL_CreateTextureFromSurface(renderer.get(), surface.get()));
-        return texture;
+        return backend->createTextureFromSurface(surfaces.get(surface));
     };
 
-    void Draw::createEmptyTexture(std::shared_ptr<SDL_Texture> texture, SDL_Color &c, int x, int y, int w, int h)
+    TextureHandle Draw::createTextureFromSurface(const std::shared_ptr<SDL_Surface> &surface)
     {
-        texture = OWL::sdl_shared(SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 1, 1));
-        SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
-        fillTexture(texture.get(), c.r, c.g, c.b, c.a);
-        SDL_SetRenderTarget(renderer.get(), NULL);
-        createViewport(texture.get(), x, y, w, h);
+        return backend->createTextureFromSurface(surface.get());
+    };
+
+    void Draw::createEmptyTexture(TextureHandle &texture, SDL_Color &c, int x, int y, int w, int h)
+    {
+        if (!backend->isValid(texture))
+        {
+            texture = backend->createTexture(1, 1);
+            backend->setTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+        fillTexture(texture, c.r, c.g, c.b, c.a);
+        backend->setTarget(TextureHandle());
+        createViewport(texture, x, y, w, h);
     }
 
     //TODO: move to utils!
-    std::shared_ptr<SDL_Surface> Draw::loadFromFile(std::string path)
+    SurfaceHandle Draw::loadFromFile(std::string path)
     {
-        std::shared_ptr<SDL_Surface> loadedSurface = sdl_shared(IMG_Load(path.c_str()));
+        SDL_Surface *loadedSurface = IMG_Load(path.c_str());
         if (loadedSurface == nullptr)
         {
             printf("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+            return SurfaceHandle();
         }
         //Color key image
-        SDL_SetColorKey(loadedSurface.get(), SDL_TRUE, SDL_MapRGB(loadedSurface.get()->format, 0, 0xFF, 0xFF));
-        return loadedSurface;
+        SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+        return surfaces.add(loadedSurface);
     }
 
-    void Draw::drawImageFromFile(std::shared_ptr<SDL_Surface> imageSurface, int x, int y)
+    void Draw::drawImageFromFile(SurfaceHandle imageSurface, int x, int y)
     {
     }
 
-    std::shared_ptr<SDL_Texture> Draw::writeText(std::string text, SDL_Color color, int x, int y)
+    TextureHandle Draw::writeText(const char *text, SDL_Color color, int x, int y)
     {
-        auto textSurface = loadFromRenderedText(text, color);
-        auto textTexture = createTextureFromSurface(textSurface);
+        MemoryScope scope(MemoryTag::TEXT);
+        auto textTexture = createText(text, color);
+        transientTextures.push_back(textTexture);
         return textTexture;
         //render(textTexture, x, y, width, height);
     };
 
+    TextureHandle Draw::createText(const char *text, SDL_Color color)
+    {
+        MemoryScope scope(MemoryTag::TEXT);
+        auto textSurface = loadFromRenderedText(text, color);
+        auto textTexture = createTextureFromSurface(textSurface);
+        surfaces.release(textSurface);
+        return textTexture;
+    }
+
     void Draw::update()
     {
-        SDL_RenderPresent(renderer.get());
+        MemoryScope scope(MemoryTag::RENDER);
+        // SDL_Renderer's back buffer is undefined after present, so the frame is read back just before it
+        captureIfRequested();
+        backend->present();
+        frameNumber++;
+        // text textures only live for the frame they were written in
+        for (auto texture : transientTextures)
+            backend->destroyTexture(texture);
+        transientTextures.clear();
         // set the default color back to black
-        SDL_SetRenderDrawColor(renderer.get(), 0, 0, 0, 255);
+        backend->setDrawColor({0, 0, 0, 255});
     }
 
-    void Draw::createViewport(SDL_Texture *texture, int x, int y, int w, int h)
+    void Draw::captureFrame(uint64_t frame, std::string path)
+    {
+        captures.push_back({frame, path});
+    }
+
+    void Draw::captureIfRequested()
+    {
+        for (size_t i = 0; i < captures.size(); i++)
+        {
+            if (captures[i].first != frameNumber)
+                continue;
+            if (backend->readPixels(captureImage) && savePNG(captureImage, captures[i].second))
+                send({"captured frame " + std::to_string(frameNumber) + " to " + captures[i].second});
+            captures.erase(captures.begin() + i);
+            i--;
+        }
+    }
+
+    void Draw::clear()
+    {
+        backend->clear();
+    }
+
+    void Draw::setViewport(const SDL_Rect *rect)
+    {
+        backend->setViewport(rect);
+    }
+
+    void Draw::createViewport(TextureHandle texture, int x, int y, int w, int h)
     {
         //Top left corner viewport
         SDL_Rect viewport;
@@ -88,20 +152,20 @@ namespace OWL
         viewport.y = y;
         viewport.w = w;
         viewport.h = h;
-        SDL_RenderSetViewport(renderer.get(), &viewport);
+        backend->setViewport(&viewport);
 
         //Render texture to screen
-        SDL_RenderCopy(renderer.get(), texture, NULL, NULL);
+        backend->copy(texture, NULL, NULL);
     }
-    void Draw::fillTexture(SDL_Texture *texture, int r, int g, int b, int a)
+    void Draw::fillTexture(TextureHandle texture, int r, int g, int b, int a)
     {
-        SDL_SetRenderTarget(renderer.get(), texture);
-        SDL_SetRenderDrawBlendMode(renderer.get(), SDL_BLENDMODE_NONE);
-        SDL_SetRenderDrawColor(renderer.get(), r, g, b, a);
-        SDL_RenderFillRect(renderer.get(), NULL);
+        backend->setTarget(texture);
+        backend->setDrawBlendMode(SDL_BLENDMODE_NONE);
+        backend->setDrawColor({(Uint8)r, (Uint8)g, (Uint8)b, (Uint8)a});
+        backend->fillRect(NULL);
     }
 
-    std::shared_ptr<SDL_Surface> Draw::loadFromRenderedText(std::string textureText, SDL_Color textColor)
+    SurfaceHandle Draw::loadFromRenderedText(const char *textureText, SDL_Color textColor)
     {
         if (!font)
         {
@@ -110,8 +174,7 @@ namespace OWL
         }
 
         //Render text surface
-        std::shared_ptr<SDL_Surface> textSurface = OWL::sdl_shared(TTF_RenderText_Blended(font, textureText.c_str(), textColor));
-        return textSurface;
+        return surfaces.add(TTF_RenderText_Blended(font, textureText, textColor));
     }
 
     void Draw::drawBox(int x, int y, int w, int h, SDL_Color c, int t)
@@ -123,14 +186,27 @@ namespace OWL
             {w / t - 1, h / t - 1},
             {x, h / t - 1},
             {x, y}};
-        SDL_SetRenderDrawColor(renderer.get(), c.r, c.g, c.b, c.a);
-        SDL_RenderSetScale(renderer.get(), t, t);
-        SDL_RenderDrawLines(renderer.get(), points, 5);
+        backend->setDrawColor(c);
+        backend->setScale(t, t);
+        backend->drawLines(points, 5);
         reset();
     }
     void Draw::reset()
     {
-        SDL_SetRenderDrawColor(renderer.get(), 0, 0, 0, 255);
-        SDL_RenderSetScale(renderer.get(), 1, 1);
+        backend->setDrawColor({0, 0, 0, 255});
+        backend->setScale(1, 1);
+    }
+
+    void Draw::onNotify(const Message &msg)
+    {
+        if (msg.getParameter(0) != ":renderstate")
+            return;
+        static const char *names[] = {"target", "viewport", "scale", "color", "blend"};
+        const RenderStateStats &stats = backend->lastFrame();
+        std::string line = "render state changes: " + std::to_string(stats.totalIssued()) + " issued, " +
+                           std::to_string(stats.totalElided()) + " elided" + (backend->isEnabled() ? "" : " (cache off)");
+        for (int i = 0; i < (int)RenderState::COUNT; i++)
+            line += std::string(", ") + names[i] + " " + std::to_string(stats.issued[i]) + "/" + std::to_string(stats.elided[i]);
+        send({line});
     }
 } // namespace OWL
\ No newline at end of file
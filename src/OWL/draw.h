@@ -7,7 +7,10 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include "backend.h"
 #include "msg.h"
+#include "pool.h"
+#include "state_cache.h"
 #include "utils.h"
 
 //==============================================================================
@@ -15,35 +18,81 @@ namespace OWL
 {
     /**
      * @brief class for all draw&render functions
-     * @details
-     * @param window reference to SDL_Window instace
+     * @details All rendering goes through a RenderBackend, picked with backendType.
+     * State changes that wouldn't change anything are dropped on the way (see state_cache.h),
+     * so callers can set what they need without tracking what is already set.
+     * OWL_STATE_CACHE=off forwards them all. ":renderstate" reports the last frame's counts.
+     * @param window reference to SDL_Window instace, can be NULL with the CPU backend
+     * @param backendType which RenderBackend to draw with
      */
     class Draw : public BusNode
     {
     public:
         //==============================================================================
-        Draw(const std::shared_ptr<MessageBus> msgBus, SDL_Window *window);
+        Draw(const std::shared_ptr<MessageBus> msgBus, SDL_Window *window, RenderBackendType backendType = RenderBackendType::SDL);
+        /// Draw with a backend made elsewhere, e.g. a RecordingBackend when rendering happens on another thread.
+        Draw(const std::shared_ptr<MessageBus> msgBus, std::unique_ptr<RenderBackend> renderBackend);
         ~Draw(){};
         //==============================================================================
 
         void update();
         void reset();
-        std::shared_ptr<SDL_Renderer> renderer = nullptr;
-        std::shared_ptr<SDL_Texture> createTextureFromSurface(std::shared_ptr<SDL_Surface> surface);
-        std::shared_ptr<SDL_Surface> loadFromFile(std::string path);
-        std::shared_ptr<SDL_Texture> writeText(std::string text, SDL_Color color, int x, int y);
-        std::shared_ptr<SDL_Surface> loadFromRenderedText(std::string textureText, SDL_Color textColor);
-        void render(std::shared_ptr<SDL_Texture> texture, int x, int y, int width, int height, SDL_Rect *clip = NULL, double angle = 0.0, SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
-        void createViewport(SDL_Texture *texture, int x, int y, int w, int h);
-        void fillTexture(SDL_Texture *texture, int r, int g, int b, int a);
-        void drawImageFromFile(std::shared_ptr<SDL_Surface> imageSurface, int x, int y);
+        /// Clear the whole screen to the draw color.
+        void clear();
+        /// NULL resets the viewport to the whole screen.
+        void setViewport(const SDL_Rect *rect);
+        TextureHandle createTextureFromSurface(SurfaceHandle surface);
+        SurfaceHandle loadFromFile(std::string path);
+        /// The returned text texture is transient: it is released after the next update().
+        TextureHandle writeText(const char *text, SDL_Color color, int x, int y);
+        /// Text rendered into a texture the caller keeps, release it with destroyTexture().
+        /// For text that stays the same over many frames, where writeText() would make a texture every frame.
+        TextureHandle createText(const char *text, SDL_Color color);
+        TextureHandle createText(const std::string &text, SDL_Color color) { return createText(text.c_str(), color); }
+        TextureHandle writeText(const std::string &text, SDL_Color color, int x, int y) { return writeText(text.c_str(), color, x, y); }
+        SurfaceHandle loadFromRenderedText(const char *textureText, SDL_Color textColor);
+        void render(TextureHandle texture, int x, int y, int width, int height, SDL_Rect *clip = NULL, double angle = 0.0, SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
+        void createViewport(TextureHandle texture, int x, int y, int w, int h);
+        void fillTexture(TextureHandle texture, int r, int g, int b, int a);
+        void drawImageFromFile(SurfaceHandle imageSurface, int x, int y);
         void drawBox(int x, int y, int w, int h, SDL_Color c, int thickness);
-        void createEmptyTexture(std::shared_ptr<SDL_Texture> texture, SDL_Color &c, int x, int y, int w, int h);
+        /// Draw a batch of quads from one texture with a single backend call.
+        void drawSprites(TextureHandle texture, const Sprite *sprites, int count) { backend->drawSprites(texture, sprites, count); }
+        /// Creates the texture on first use, and reuses it while the handle stays valid.
+        void createEmptyTexture(TextureHandle &texture, SDL_Color &c, int x, int y, int w, int h);
+
+        //=== frame capture ===
+        /// Save the frame presented by the frame'th update() (counting from 0) as a PNG.
+        void captureFrame(uint64_t frame, std::string path);
+        /// Number of frames presented so far.
+        uint64_t getFrameNumber() const { return frameNumber; }
+
+        //=== resources ===
+        SDL_Surface *getSurface(SurfaceHandle surface) const { return surfaces.get(surface); }
+        void queryTexture(TextureHandle texture, int *w, int *h) { backend->queryTexture(texture, w, h); }
+        void destroyTexture(TextureHandle texture) { backend->destroyTexture(texture); }
+        bool isValid(TextureHandle texture) const { return backend->isValid(texture); }
+        void destroySurface(SurfaceHandle surface) { surfaces.release(surface); }
+        RenderBackend &getBackend() { return *backend; }
+        /// State changes issued and elided in the last presented frame.
+        const RenderStateStats &getStateStats() const { return backend->lastFrame(); }
+
+        //=== shared_ptr compatibility shim, kept while callers move over to handles ===
+        TextureHandle createTextureFromSurface(const std::shared_ptr<SDL_Surface> &surface);
 
     private:
         TTF_Font *font = nullptr;
         int width;
         int height;
+        std::unique_ptr<StateCacheBackend> backend; // owns the textures
+        ResourcePool<SDL_Surface> surfaces;
+        std::vector<TextureHandle> transientTextures; // released after present
+        uint64_t frameNumber{0};
+        std::vector<std::pair<uint64_t, std::string>> captures; // pending frame captures
+        Image captureImage;
+
+        void captureIfRequested();
+        void onNotify(const Message &msg);
     };
 
 } // namespace OWL
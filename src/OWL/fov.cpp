@@ -0,0 +1,281 @@
+#include "fov.h"
+#include <assert.h>
+#include <stdlib.h>
+
+namespace OWL
+{
+    static const uint8_t allOctants = 0xff;
+
+    static int floorDiv(int a, int b)
+    {
+        return a / b - (a % b != 0 && (a < 0) != (b < 0));
+    }
+
+    FieldOfView::FieldOfView(int width, int height)
+        : opaque{width, height}, visible{width, height}, explored{width, height}, seenBy((size_t)width * height, 0),
+          chunkWidth{(width + chunkSize - 1) >> chunkShift}, chunkHeight{(height + chunkSize - 1) >> chunkShift},
+          chunkVisible((size_t)chunkWidth * chunkHeight, 0), chunkExplored((size_t)chunkWidth * chunkHeight, 0)
+    {
+    }
+
+    void FieldOfView::setOpaque(int x, int y, bool isOpaque)
+    {
+        if (!opaque.inside(x, y) || opaque.get(x, y) == isOpaque)
+            return;
+        if (isOpaque)
+            opaque.set(x, y);
+        else
+            opaque.reset(x, y);
+        // viewers may still move before the update, so the octants are picked there
+        changedTiles.push_back((uint32_t)y * getWidth() + x);
+    }
+
+    //=== viewers =================================================================
+
+    FieldOfView::Viewer *FieldOfView::find(ViewerHandle viewer)
+    {
+        if (viewer.isNull() || viewer.index() >= slots.size())
+            return nullptr;
+        Viewer &v = slots[viewer.index()];
+        return v.alive && v.generation == viewer.generation() ? &v : nullptr;
+    }
+
+    const FieldOfView::Viewer *FieldOfView::find(ViewerHandle viewer) const
+    {
+        return const_cast<FieldOfView *>(this)->find(viewer);
+    }
+
+    ViewerHandle FieldOfView::addViewer(int x, int y, int radius)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)slots.size();
+            assert(slot <= ViewerHandle::indexMask && "too many viewers");
+            slots.emplace_back();
+            slots.back().generation = 1;
+        }
+        Viewer &v = slots[slot];
+        v.x = x, v.y = y, v.radius = std::max(radius, 0);
+        v.alive = true;
+        v.dirty = 0;
+        markDirty(slot, allOctants);
+        return ViewerHandle::make(slot, v.generation);
+    }
+
+    void FieldOfView::removeViewer(ViewerHandle viewer)
+    {
+        Viewer *v = find(viewer);
+        if (v == nullptr)
+            return;
+        for (auto &octant : v->octants)
+        {
+            for (uint32_t tile : octant)
+                unsee(tile);
+            octant.clear();
+        }
+        v->alive = false;
+        // a dirty slot stays listed, update() skips it unless it is reused
+        v->dirty = 0;
+        // skip generation 0 on wrap-around so the null handle stays unique
+        v->generation = (v->generation + 1) & ViewerHandle::generationMask;
+        if (v->generation == 0)
+            v->generation = 1;
+        freeSlots.push_back(viewer.index());
+    }
+
+    void FieldOfView::moveViewer(ViewerHandle viewer, int x, int y)
+    {
+        Viewer *v = find(viewer);
+        if (v == nullptr || (v->x == x && v->y == y))
+            return;
+        v->x = x, v->y = y;
+        markDirty(viewer.index(), allOctants);
+    }
+
+    void FieldOfView::setRadius(ViewerHandle viewer, int radius)
+    {
+        Viewer *v = find(viewer);
+        if (v == nullptr || v->radius == std::max(radius, 0))
+            return;
+        v->radius = std::max(radius, 0);
+        markDirty(viewer.index(), allOctants);
+    }
+
+    void FieldOfView::markDirty(uint32_t slot, uint8_t octants)
+    {
+        Viewer &v = slots[slot];
+        if (v.dirty == 0)
+            dirtyViewers.push_back(slot);
+        v.dirty |= octants;
+    }
+
+    void FieldOfView::tileChanged(int x, int y)
+    {
+        for (uint32_t slot = 0; slot < slots.size(); slot++)
+        {
+            const Viewer &v = slots[slot];
+            int dx = x - v.x, dy = y - v.y;
+            if (!v.alive || v.dirty == allOctants || abs(dx) > v.radius || abs(dy) > v.radius || (dx == 0 && dy == 0))
+                continue;
+            // the tile in each quadrant's (depth, column) coordinates, see scan()
+            const int depths[4] = {-dy, dx, dy, -dx};
+            const int cols[4] = {dx, dy, dx, dy};
+            uint8_t octants = 0;
+            for (int quadrant = 0; quadrant < 4; quadrant++)
+            {
+                int depth = depths[quadrant], col = cols[quadrant];
+                if (depth <= 0 || abs(col) > depth)
+                    continue;
+                if (col <= 0)
+                    octants |= 1 << (quadrant * 2);
+                if (col >= 0)
+                    octants |= 1 << (quadrant * 2 + 1);
+            }
+            markDirty(slot, octants);
+        }
+    }
+
+    //=== update ==================================================================
+
+    size_t FieldOfView::update()
+    {
+        for (uint32_t tile : changedTiles)
+            tileChanged(tile % getWidth(), tile / getWidth());
+        changedTiles.clear();
+
+        size_t rescanned = 0;
+        for (uint32_t slot : dirtyViewers)
+        {
+            Viewer &v = slots[slot];
+            for (int octant = 0; octant < 8; octant++)
+            {
+                if (v.dirty & 1 << octant)
+                {
+                    rescan(v, octant);
+                    rescanned++;
+                }
+            }
+            v.dirty = 0;
+        }
+        dirtyViewers.clear();
+        return rescanned;
+    }
+
+    void FieldOfView::invalidateAll()
+    {
+        for (uint32_t slot = 0; slot < slots.size(); slot++)
+            if (slots[slot].alive)
+                markDirty(slot, allOctants);
+    }
+
+    void FieldOfView::resetExplored()
+    {
+        explored.clear();
+        std::fill(chunkExplored.begin(), chunkExplored.end(), 0);
+        for (int y = 0; y < getHeight(); y++)
+            for (int x = 0; x < getWidth(); x++)
+                if (visible.get(x, y))
+                {
+                    explored.set(x, y);
+                    chunkExplored[(y >> chunkShift) * chunkWidth + (x >> chunkShift)] = 1;
+                }
+    }
+
+    void FieldOfView::see(uint32_t tile)
+    {
+        if (seenBy[tile]++ != 0)
+            return;
+        int x = tile % getWidth(), y = tile / getWidth();
+        size_t chunk = (y >> chunkShift) * chunkWidth + (x >> chunkShift);
+        visible.set(x, y);
+        explored.set(x, y);
+        chunkVisible[chunk]++;
+        chunkExplored[chunk] = 1;
+    }
+
+    void FieldOfView::unsee(uint32_t tile)
+    {
+        if (--seenBy[tile] != 0)
+            return;
+        int x = tile % getWidth(), y = tile / getWidth();
+        visible.reset(x, y);
+        chunkVisible[(y >> chunkShift) * chunkWidth + (x >> chunkShift)]--;
+    }
+
+    void FieldOfView::rescan(Viewer &viewer, int octant)
+    {
+        // the new tiles go in before the old ones come out, so tiles seen by both never blink off
+        std::vector<uint32_t> &tiles = viewer.octants[octant];
+        size_t old = tiles.size();
+        if (octant == 0 && opaque.inside(viewer.x, viewer.y))
+            tiles.push_back((uint32_t)viewer.y * getWidth() + viewer.x);
+        // half 0 covers columns left of the quadrant's center line, half 1 those right of it
+        if (octant % 2 == 0)
+            scan(viewer, octant, 1, {-1, 1}, {0, 1}, tiles);
+        else
+            scan(viewer, octant, 1, {0, 1}, {1, 1}, tiles);
+        for (size_t i = old; i < tiles.size(); i++)
+            see(tiles[i]);
+        for (size_t i = 0; i < old; i++)
+            unsee(tiles[i]);
+        tiles.erase(tiles.begin(), tiles.begin() + old);
+    }
+
+    /**
+     * One row of an octant, then the rows behind it. depth counts rows away from the viewer
+     * and col runs across the row, 0 on the quadrant's center line. The quadrants are north,
+     * east, south and west, and each octant is one half of a quadrant. start and end bound
+     * the slopes col / depth still lit.
+     */
+    void FieldOfView::scan(const Viewer &viewer, int octant, int depth, Slope start, Slope end, std::vector<uint32_t> &out)
+    {
+        if (depth > viewer.radius)
+            return;
+        // depth * slope rounded to a column, ties towards the lit side
+        int minCol = floorDiv(2 * depth * start.num + start.den, 2 * start.den);
+        int maxCol = -floorDiv(-(2 * depth * end.num - end.den), 2 * end.den);
+        int radiusSquared = viewer.radius * viewer.radius + viewer.radius;
+
+        int previous = -1; // -1 before the first tile, else whether the previous one was a wall
+        for (int col = minCol; col <= maxCol; col++)
+        {
+            int x, y;
+            switch (octant >> 1)
+            {
+            case 0:
+                x = viewer.x + col, y = viewer.y - depth;
+                break;
+            case 1:
+                x = viewer.x + depth, y = viewer.y + col;
+                break;
+            case 2:
+                x = viewer.x + col, y = viewer.y + depth;
+                break;
+            default:
+                x = viewer.x - depth, y = viewer.y + col;
+                break;
+            }
+            bool inside = opaque.inside(x, y);
+            bool wall = !inside || opaque.get(x, y);
+            // a floor tile is only seen if its center is in the lit cone, which is what makes this symmetric
+            bool symmetric = col * start.den >= depth * start.num && col * end.den <= depth * end.num;
+            if (inside && (wall || symmetric) && col * col + depth * depth <= radiusSquared)
+                out.push_back((uint32_t)y * getWidth() + x);
+
+            if (previous == 1 && !wall)
+                start = {2 * col - 1, 2 * depth};
+            if (previous == 0 && wall)
+                scan(viewer, octant, depth + 1, start, {2 * col - 1, 2 * depth}, out);
+            previous = wall;
+        }
+        if (previous == 0)
+            scan(viewer, octant, depth + 1, start, end, out);
+    }
+
+} // namespace OWL
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "pool.h"
+
+namespace OWL
+{
+    /// One bit per tile, rows padded to whole 64-bit words.
+    class BitGrid
+    {
+    public:
+        BitGrid(int width, int height)
+            : width{width}, height{height}, words{(width + 63) / 64}, bits((size_t)words * height, 0) {}
+
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+        int wordsPerRow() const { return words; }
+        bool inside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+
+        bool get(int x, int y) const { return bits[(size_t)y * words + (x >> 6)] >> (x & 63) & 1; }
+        void set(int x, int y) { bits[(size_t)y * words + (x >> 6)] |= 1ull << (x & 63); }
+        void reset(int x, int y) { bits[(size_t)y * words + (x >> 6)] &= ~(1ull << (x & 63)); }
+        void clear() { std::fill(bits.begin(), bits.end(), 0); }
+        const uint64_t *row(int y) const { return &bits[(size_t)y * words]; }
+
+    private:
+        int width, height, words;
+        std::vector<uint64_t> bits;
+    };
+
+    struct ViewerTag;
+    typedef Handle<ViewerTag> ViewerHandle;
+
+    /**
+     * @brief Field of view and fog of war for any number of viewers on a tile grid.
+     * @details Uses symmetric shadowcasting: a tile is visible from a viewer exactly when the
+     * viewer is visible from it, walls are lit when seen, and there are no blind corners
+     * around pillars. Slopes are kept as exact fractions, so the result doesn't depend on
+     * float rounding. Every viewer sees the tiles within radius + 0.5 of it.
+     *
+     * The grid is split around each viewer into eight octants, scanned row by row and
+     * recursively split at walls. Each octant keeps the list of tiles it saw, and every tile
+     * keeps a count of the octants that see it, so update() only rescans what changed: all
+     * octants of a viewer that moved or changed radius, and the octants of other viewers
+     * that a changed tile lies in. Recomputing an octant takes its old tiles back out of the
+     * counts and puts the new ones in.
+     *
+     * The union of what all viewers see is kept as a packed bitmap, as is everything that
+     * was ever visible (explored). Both are also summed up per chunk of chunkSize tiles, so
+     * a renderer can skip whole chunks that are dark or unexplored.
+     *
+     * Opacity is a packed bitmap as well. Tiles outside the grid are walls.
+     */
+    class FieldOfView
+    {
+    public:
+        static const int chunkShift = 4;
+        static const int chunkSize = 1 << chunkShift; // tiles per chunk side
+
+        FieldOfView(int width, int height);
+
+        int getWidth() const { return opaque.getWidth(); }
+        int getHeight() const { return opaque.getHeight(); }
+
+        void setOpaque(int x, int y, bool isOpaque);
+        bool isOpaque(int x, int y) const { return !opaque.inside(x, y) || opaque.get(x, y); }
+
+        ViewerHandle addViewer(int x, int y, int radius);
+        /// Takes what the viewer saw out of the visible set right away.
+        void removeViewer(ViewerHandle viewer);
+        bool isValid(ViewerHandle viewer) const { return find(viewer) != nullptr; }
+        void moveViewer(ViewerHandle viewer, int x, int y);
+        void setRadius(ViewerHandle viewer, int radius);
+
+        /// Rescan the octants touched by moves and tile changes since the last update. Returns how many were rescanned.
+        size_t update();
+        /// Rescan everything on the next update, e.g. after the whole map was replaced.
+        void invalidateAll();
+        /// Forget what was explored. What is visible now stays explored.
+        void resetExplored();
+
+        bool isVisible(int x, int y) const { return visible.inside(x, y) && visible.get(x, y); }
+        bool isExplored(int x, int y) const { return explored.inside(x, y) && explored.get(x, y); }
+        /// Packed bitmaps, bit x & 63 of word x >> 6 of a row is tile x.
+        const BitGrid &getVisible() const { return visible; }
+        const BitGrid &getExplored() const { return explored; }
+
+        int chunkColumns() const { return chunkWidth; }
+        int chunkRows() const { return chunkHeight; }
+        /// Some tile of the chunk is visible.
+        bool isChunkVisible(int cx, int cy) const { return chunkVisible[cy * chunkWidth + cx] > 0; }
+        /// Some tile of the chunk was explored.
+        bool isChunkExplored(int cx, int cy) const { return chunkExplored[cy * chunkWidth + cx] != 0; }
+
+        size_t viewerCount() const { return slots.size() - freeSlots.size(); }
+
+    private:
+        /// A fraction num / den with den > 0.
+        struct Slope
+        {
+            int num, den;
+        };
+        struct Viewer
+        {
+            int x, y, radius;
+            uint32_t generation;
+            bool alive;
+            uint8_t dirty;                    // octants to rescan, one bit each
+            std::vector<uint32_t> octants[8]; // tiles each octant sees, as y * width + x
+        };
+
+        BitGrid opaque, visible, explored;
+        std::vector<uint32_t> seenBy; // octants seeing each tile
+        int chunkWidth, chunkHeight;
+        std::vector<uint32_t> chunkVisible; // visible tiles per chunk
+        std::vector<uint8_t> chunkExplored;
+
+        std::vector<Viewer> slots;
+        std::vector<uint32_t> freeSlots;
+        std::vector<uint32_t> dirtyViewers;  // slots with dirty octants
+        std::vector<uint32_t> changedTiles;  // opacity changes since the last update
+
+        Viewer *find(ViewerHandle viewer);
+        const Viewer *find(ViewerHandle viewer) const;
+        void markDirty(uint32_t slot, uint8_t octants);
+        /// Mark the octants of every viewer that scan the tile.
+        void tileChanged(int x, int y);
+
+        void rescan(Viewer &viewer, int octant);
+        void scan(const Viewer &viewer, int octant, int depth, Slope start, Slope end, std::vector<uint32_t> &out);
+        void see(uint32_t tile);
+        void unsee(uint32_t tile);
+    };
+
+} // namespace OWL
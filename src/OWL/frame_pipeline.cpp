@@ -0,0 +1,366 @@
+#include "frame_pipeline.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace OWL
+{
+    static uint64_t nowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //=== CommandList =============================================================
+
+    RenderCommand &CommandList::add(RenderCommand::Type type)
+    {
+        commands.push_back(RenderCommand{});
+        commands.back().type = type;
+        return commands.back();
+    }
+
+    void CommandList::clear()
+    {
+        for (auto &command : commands)
+            if (command.surface != nullptr)
+                SDL_FreeSurface(command.surface);
+        commands.clear();
+        points.clear();
+        sprites.clear();
+        inputMicros = 0;
+    }
+
+    //=== FramePipeline, simulation side ==========================================
+
+    void FramePipeline::submit()
+    {
+        uint64_t frame = submitted.load(std::memory_order_relaxed);
+        lists[frame % depth].inputMicros = oldestInput;
+        oldestInput = 0;
+        // the release makes the list visible to the render thread before the new count
+        submitted.store(frame + 1, std::memory_order_release);
+
+        // the next slot is free once the render thread has finished the frame that used it
+        while (frame + 1 - replayed.load(std::memory_order_acquire) >= (uint64_t)depth)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        lists[(frame + 1) % depth].clear();
+    }
+
+    int FramePipeline::pollEvent(SDL_Event *event)
+    {
+        InputEvent input;
+        if (!events.pop(input))
+            return 0;
+        *event = input.event;
+        if (oldestInput == 0)
+            oldestInput = input.micros;
+        return 1;
+    }
+
+    void FramePipeline::close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+    LatencyStats FramePipeline::latency() const
+    {
+        return {latencyAverage.load(std::memory_order_relaxed), latencyMax.load(std::memory_order_relaxed),
+                latencySamples.load(std::memory_order_relaxed)};
+    }
+
+    //=== FramePipeline, render side ==============================================
+
+    void FramePipeline::pumpEvents()
+    {
+        int wanted = textInput.exchange(-1, std::memory_order_relaxed);
+        if (wanted == 1)
+            SDL_StartTextInput();
+        else if (wanted == 0)
+            SDL_StopTextInput();
+
+        InputEvent input;
+        while (SDL_PollEvent(&input.event) != 0)
+        {
+            input.micros = nowMicros();
+            // a full queue means the simulation is stuck, losing input then is the lesser evil
+            events.push(input);
+        }
+    }
+
+    TextureHandle FramePipeline::backendTexture(TextureHandle recorded) const
+    {
+        if (recorded.index() >= textures.size() || textures[recorded.index()].generation != recorded.generation())
+            return TextureHandle();
+        return textures[recorded.index()].texture;
+    }
+
+    void FramePipeline::mapTexture(TextureHandle recorded, TextureHandle texture)
+    {
+        if (recorded.index() >= textures.size())
+            textures.resize(recorded.index() + 1);
+        textures[recorded.index()] = {recorded.generation(), texture};
+    }
+
+    bool FramePipeline::replay(RenderBackend &backend, int timeoutMs)
+    {
+        uint64_t frame = replayed.load(std::memory_order_relaxed);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (submitted.load(std::memory_order_acquire) == frame)
+        {
+            if (closed.load(std::memory_order_acquire) || std::chrono::steady_clock::now() >= deadline)
+                return false;
+            // keep the window responsive while waiting
+            pumpEvents();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+
+        const CommandList &list = lists[frame % depth];
+        execute(list, backend);
+        for (size_t i = 0; i < captures.size(); i++)
+        {
+            if (captures[i].first != frame)
+                continue;
+            if (backend.readPixels(captureImage) && savePNG(captureImage, captures[i].second))
+                printf("captured frame %llu to %s\n", (unsigned long long)frame, captures[i].second.c_str());
+            captures.erase(captures.begin() + i);
+            i--;
+        }
+        backend.present();
+        if (list.inputMicros != 0)
+            addLatency(nowMicros(), list.inputMicros);
+        replayed.store(frame + 1, std::memory_order_release);
+        return true;
+    }
+
+    void FramePipeline::addLatency(uint64_t now, uint64_t inputMicros)
+    {
+        uint32_t micros = (uint32_t)std::min<uint64_t>(now - inputMicros, UINT32_MAX);
+        windowTotal += micros;
+        windowMax = std::max(windowMax, micros);
+        windowSamples++;
+        if (windowStart == 0)
+            windowStart = now;
+        if (now - windowStart < 1000000)
+            return;
+        latencyAverage.store((uint32_t)(windowTotal / windowSamples), std::memory_order_relaxed);
+        latencyMax.store(windowMax, std::memory_order_relaxed);
+        latencySamples.store(windowSamples, std::memory_order_relaxed);
+        windowStart = now;
+        windowTotal = windowMax = windowSamples = 0;
+    }
+
+    void FramePipeline::execute(const CommandList &list, RenderBackend &backend)
+    {
+        for (const RenderCommand &c : list.commands)
+        {
+            TextureHandle texture;
+            if (c.texture && c.type != RenderCommand::CREATE_TEXTURE && c.type != RenderCommand::CREATE_FROM_SURFACE)
+            {
+                texture = backendTexture(c.texture);
+                // a stale recorded handle whose slot was reused: the backends ignore those too,
+                // and for a target it means the screen
+                if (!texture && c.type != RenderCommand::SET_TARGET)
+                    continue;
+            }
+            const SDL_Rect *src = c.flags & RenderCommand::HAS_SRC ? &c.src : NULL;
+            const SDL_Rect *dst = c.flags & RenderCommand::HAS_DST ? &c.dst : NULL;
+            switch (c.type)
+            {
+            case RenderCommand::CREATE_TEXTURE:
+            {
+                MemoryScope scope(c.tag);
+                mapTexture(c.texture, backend.createTexture(c.dst.w, c.dst.h));
+                break;
+            }
+            case RenderCommand::CREATE_FROM_SURFACE:
+            {
+                // backends copy the pixels, the surface is freed when the list is cleared for reuse
+                MemoryScope scope(c.tag);
+                mapTexture(c.texture, backend.createTextureFromSurface(c.surface));
+                break;
+            }
+            case RenderCommand::DESTROY_TEXTURE:
+                backend.destroyTexture(texture);
+                mapTexture(c.texture, TextureHandle());
+                break;
+            case RenderCommand::TEXTURE_BLEND_MODE:
+                backend.setTextureBlendMode(texture, c.blend);
+                break;
+            case RenderCommand::SET_TARGET:
+                backend.setTarget(texture);
+                break;
+            case RenderCommand::SET_VIEWPORT:
+                backend.setViewport(dst);
+                break;
+            case RenderCommand::SET_SCALE:
+                backend.setScale(c.scaleX, c.scaleY);
+                break;
+            case RenderCommand::SET_DRAW_COLOR:
+                backend.setDrawColor(c.color);
+                break;
+            case RenderCommand::SET_DRAW_BLEND_MODE:
+                backend.setDrawBlendMode(c.blend);
+                break;
+            case RenderCommand::CLEAR:
+                backend.clear();
+                break;
+            case RenderCommand::FILL_RECT:
+                backend.fillRect(dst);
+                break;
+            case RenderCommand::DRAW_LINES:
+                backend.drawLines(&list.points[c.first], c.count);
+                break;
+            case RenderCommand::COPY:
+                backend.copy(texture, src, dst, c.angle, c.flags & RenderCommand::HAS_CENTER ? &c.center : NULL, c.flip);
+                break;
+            case RenderCommand::DRAW_SPRITES:
+                backend.drawSprites(texture, &list.sprites[c.first], c.count);
+                break;
+            }
+        }
+    }
+
+    //=== RecordingBackend ========================================================
+
+    RecordingBackend::RecordingBackend(FramePipeline &pipeline, const std::string &targetName)
+        : pipeline{pipeline}, label{targetName + ", threaded"} {}
+
+    TextureHandle RecordingBackend::createTexture(int w, int h)
+    {
+        TextureHandle texture = textures.add(new Size{w, h});
+        RenderCommand &c = add(RenderCommand::CREATE_TEXTURE);
+        c.texture = texture;
+        c.tag = MemoryScope::current();
+        c.dst.w = w;
+        c.dst.h = h;
+        return texture;
+    }
+
+    TextureHandle RecordingBackend::createTextureFromSurface(SDL_Surface *surface)
+    {
+        if (surface == nullptr)
+            return TextureHandle();
+        SDL_Surface *copy = SDL_DuplicateSurface(surface);
+        if (copy == nullptr)
+        {
+            printf("Unable to copy surface for the render thread! SDL_Error: %s\n", SDL_GetError());
+            return TextureHandle();
+        }
+        TextureHandle texture = textures.add(new Size{surface->w, surface->h});
+        RenderCommand &c = add(RenderCommand::CREATE_FROM_SURFACE);
+        c.texture = texture;
+        c.surface = copy;
+        c.tag = MemoryScope::current();
+        return texture;
+    }
+
+    void RecordingBackend::destroyTexture(TextureHandle texture)
+    {
+        if (!textures.isValid(texture))
+            return;
+        textures.release(texture);
+        add(RenderCommand::DESTROY_TEXTURE).texture = texture;
+    }
+
+    void RecordingBackend::queryTexture(TextureHandle texture, int *w, int *h)
+    {
+        Size *size = textures.get(texture);
+        if (w != nullptr)
+            *w = size ? size->w : 0;
+        if (h != nullptr)
+            *h = size ? size->h : 0;
+    }
+
+    void RecordingBackend::setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode)
+    {
+        RenderCommand &c = add(RenderCommand::TEXTURE_BLEND_MODE);
+        c.texture = texture;
+        c.blend = mode;
+    }
+
+    void RecordingBackend::setTarget(TextureHandle texture)
+    {
+        // a stale handle means the screen, as on the other backends
+        add(RenderCommand::SET_TARGET).texture = textures.isValid(texture) ? texture : TextureHandle();
+    }
+
+    void RecordingBackend::setViewport(const SDL_Rect *rect)
+    {
+        RenderCommand &c = add(RenderCommand::SET_VIEWPORT);
+        if (rect != NULL)
+        {
+            c.flags = RenderCommand::HAS_DST;
+            c.dst = *rect;
+        }
+    }
+
+    void RecordingBackend::setScale(float scaleX, float scaleY)
+    {
+        RenderCommand &c = add(RenderCommand::SET_SCALE);
+        c.scaleX = scaleX;
+        c.scaleY = scaleY;
+    }
+
+    void RecordingBackend::setDrawColor(SDL_Color color)
+    {
+        add(RenderCommand::SET_DRAW_COLOR).color = color;
+    }
+
+    void RecordingBackend::setDrawBlendMode(SDL_BlendMode mode)
+    {
+        add(RenderCommand::SET_DRAW_BLEND_MODE).blend = mode;
+    }
+
+    void RecordingBackend::clear()
+    {
+        add(RenderCommand::CLEAR);
+    }
+
+    void RecordingBackend::fillRect(const SDL_Rect *rect)
+    {
+        RenderCommand &c = add(RenderCommand::FILL_RECT);
+        if (rect != NULL)
+        {
+            c.flags = RenderCommand::HAS_DST;
+            c.dst = *rect;
+        }
+    }
+
+    void RecordingBackend::drawLines(const SDL_Point *points, int count)
+    {
+        MemoryScope scope(MemoryTag::RENDER);
+        CommandList &list = pipeline.recording();
+        RenderCommand &c = list.add(RenderCommand::DRAW_LINES);
+        c.first = (uint32_t)list.points.size();
+        c.count = count;
+        list.points.insert(list.points.end(), points, points + count);
+    }
+
+    void RecordingBackend::copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                                double angle, const SDL_Point *center, SDL_RendererFlip flip)
+    {
+        RenderCommand &c = add(RenderCommand::COPY);
+        c.texture = texture;
+        if (src != NULL)
+            c.flags |= RenderCommand::HAS_SRC, c.src = *src;
+        if (dst != NULL)
+            c.flags |= RenderCommand::HAS_DST, c.dst = *dst;
+        if (center != NULL)
+            c.flags |= RenderCommand::HAS_CENTER, c.center = *center;
+        c.angle = angle;
+        c.flip = flip;
+    }
+
+    void RecordingBackend::drawSprites(TextureHandle texture, const Sprite *sprites, int count)
+    {
+        MemoryScope scope(MemoryTag::RENDER);
+        CommandList &list = pipeline.recording();
+        RenderCommand &c = list.add(RenderCommand::DRAW_SPRITES);
+        c.texture = texture;
+        c.first = (uint32_t)list.sprites.size();
+        c.count = count;
+        list.sprites.insert(list.sprites.end(), sprites, sprites + count);
+    }
+
+} // namespace OWL
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "alloc.h"
+#include "backend.h"
+#include "pool.h"
+#include "spsc.h"
+
+namespace OWL
+{
+    /// One recorded RenderBackend call. Textures are the recording side's handles.
+    struct RenderCommand
+    {
+        enum Type : uint8_t
+        {
+            CREATE_TEXTURE,      // dst.w x dst.h
+            CREATE_FROM_SURFACE, // surface
+            DESTROY_TEXTURE,
+            TEXTURE_BLEND_MODE,
+            SET_TARGET,
+            SET_VIEWPORT, // dst, or NULL without HAS_DST
+            SET_SCALE,    // scaleX, scaleY
+            SET_DRAW_COLOR,
+            SET_DRAW_BLEND_MODE,
+            CLEAR,
+            FILL_RECT,    // dst, or NULL without HAS_DST
+            DRAW_LINES,   // points [first, first + count)
+            COPY,         // src, dst, angle, center, flip
+            DRAW_SPRITES  // sprites [first, first + count)
+        };
+        enum Flags : uint8_t
+        {
+            HAS_SRC = 1,
+            HAS_DST = 2,
+            HAS_CENTER = 4
+        };
+
+        Type type;
+        uint8_t flags;
+        TextureHandle texture;
+        SDL_Rect src, dst;
+        SDL_Color color;
+        SDL_BlendMode blend;
+        SDL_RendererFlip flip;
+        SDL_Point center;
+        double angle;
+        float scaleX, scaleY;
+        uint32_t first, count;
+        SDL_Surface *surface; // CREATE_FROM_SURFACE: a copy, owned by the list
+        MemoryTag tag;        // CREATE_*: the tag the texture was created under, its pixels are accounted to it
+    };
+
+    /// Everything one frame drew, ready to be replayed on another thread.
+    struct CommandList
+    {
+        ~CommandList() { clear(); }
+
+        std::vector<RenderCommand> commands;
+        std::vector<SDL_Point> points;
+        std::vector<Sprite> sprites;
+        uint64_t inputMicros{0}; // when the oldest input this frame handled arrived, 0 for none
+
+        RenderCommand &add(RenderCommand::Type type);
+        /// Empty the list, keeping its memory, and free its surfaces.
+        void clear();
+    };
+
+    /// Input-to-present latency over the last second, in microseconds.
+    struct LatencyStats
+    {
+        uint32_t averageMicros;
+        uint32_t maxMicros;
+        uint32_t samples;
+    };
+
+    /**
+     * @brief Hands frames from a simulation thread to the thread that owns SDL.
+     * @details SDL wants its renderer and event loop on the thread that created the window,
+     * so that thread only pumps events and replays finished frames, while the game simulates
+     * on another. The simulation draws through a RecordingBackend into a CommandList, and
+     * present() submits the list.
+     *
+     * Lists live in a ring of depth slots. Two counters act as the frame fences: submitted
+     * is only written by the simulation and replayed only by the render thread, with
+     * release stores and acquire loads, so no lock is taken on either side. Frames are never
+     * dropped, since they carry texture creation and destruction. Instead the simulation
+     * waits when it is depth - 1 frames ahead. With depth 3 one list is being recorded, one is
+     * queued and one is being replayed, so a present blocking on vsync doesn't stall the
+     * simulation until it is two frames ahead.
+     *
+     * Input goes the other way: the render thread polls SDL events, stamps them and queues
+     * them for the simulation. Each frame notes its oldest input, and the time from that
+     * input to the frame's present is the latency metric. Starting and stopping SDL's text
+     * input is a video call too, so the simulation only requests it with setTextInput().
+     */
+    class FramePipeline
+    {
+    public:
+        static const int depth = 3;
+
+        //=== simulation thread ===
+        /// The list to record the current frame into.
+        CommandList &recording() { return lists[submitted.load(std::memory_order_relaxed) % depth]; }
+        /// Publish the recorded frame. Waits while depth - 1 frames are already queued.
+        void submit();
+        /// Next input event from the render thread. Same contract as SDL_PollEvent.
+        int pollEvent(SDL_Event *event);
+        /// Start or stop SDL's text input. The render thread does it at its next pumpEvents().
+        void setTextInput(bool on) { textInput.store(on, std::memory_order_relaxed); }
+        /// No more frames will come. The render thread finishes the queued ones.
+        void close();
+        LatencyStats latency() const;
+        /// Frames submitted and not replayed yet.
+        uint64_t queued() const { return submitted.load(std::memory_order_acquire) - replayed.load(std::memory_order_acquire); }
+
+        //=== render thread ===
+        /// Queue SDL's pending events for the simulation, after applying a text input change.
+        void pumpEvents();
+        /// Replay the next frame onto backend and present it. Returns false if none came within timeoutMs.
+        bool replay(RenderBackend &backend, int timeoutMs);
+        /// Closed, and every frame replayed.
+        bool isFinished() const { return closed.load(std::memory_order_acquire) && queued() == 0; }
+        /// Save the frame'th presented frame (counting from 0) as a PNG, like Draw::captureFrame.
+        void captureFrame(uint64_t frame, std::string path) { captures.push_back({frame, path}); }
+
+    private:
+        struct InputEvent
+        {
+            SDL_Event event;
+            uint64_t micros;
+        };
+
+        CommandList lists[depth];
+        alignas(64) std::atomic<uint64_t> submitted{0}; // frames published by the simulation
+        alignas(64) std::atomic<uint64_t> replayed{0};  // frames the render thread is done with
+        std::atomic<bool> closed{false};
+        std::atomic<int> textInput{-1}; // text input state to switch SDL to, -1 for no change
+        SpscQueue<InputEvent, 256> events;
+
+        // simulation thread
+        uint64_t oldestInput{0};
+
+        // render thread
+        struct MappedTexture
+        {
+            uint32_t generation; // of the recorded handle
+            TextureHandle texture;
+        };
+        std::vector<MappedTexture> textures; // backend texture for each recorded handle index
+        std::vector<std::pair<uint64_t, std::string>> captures;
+        Image captureImage;
+        uint64_t windowStart{0}, windowTotal{0};
+        uint32_t windowMax{0}, windowSamples{0};
+        std::atomic<uint32_t> latencyAverage{0}, latencyMax{0}, latencySamples{0};
+
+        /// The backend texture of a recorded handle, a null handle if the recorded one is stale.
+        TextureHandle backendTexture(TextureHandle recorded) const;
+        void mapTexture(TextureHandle recorded, TextureHandle texture);
+        void execute(const CommandList &list, RenderBackend &backend);
+        void addLatency(uint64_t now, uint64_t inputMicros);
+    };
+
+    /**
+     * @brief RenderBackend that records into a FramePipeline instead of drawing.
+     * @details Hands out its own texture handles and tracks their sizes, so Draw works
+     * unchanged on the simulation thread. Surfaces are copied, since their owner may
+     * free them before the frame is replayed. present() submits the frame.
+     * readPixels() isn't available here; capture with FramePipeline::captureFrame instead.
+     * @param targetName name of the backend the frames are replayed on, for name()
+     */
+    class RecordingBackend : public RenderBackend
+    {
+    public:
+        RecordingBackend(FramePipeline &pipeline, const std::string &targetName);
+
+        const char *name() const { return label.c_str(); }
+
+        TextureHandle createTexture(int w, int h);
+        TextureHandle createTextureFromSurface(SDL_Surface *surface);
+        void destroyTexture(TextureHandle texture);
+        bool isValid(TextureHandle texture) const { return textures.isValid(texture); }
+        void queryTexture(TextureHandle texture, int *w, int *h);
+        void setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode);
+
+        void setTarget(TextureHandle texture);
+        void setViewport(const SDL_Rect *rect);
+        void setScale(float scaleX, float scaleY);
+        void setDrawColor(SDL_Color color);
+        void setDrawBlendMode(SDL_BlendMode mode);
+
+        void clear();
+        void fillRect(const SDL_Rect *rect);
+        void drawLines(const SDL_Point *points, int count);
+        void copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                  double angle = 0.0, const SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
+        void drawSprites(TextureHandle texture, const Sprite *sprites, int count);
+        void present() { pipeline.submit(); }
+        bool readPixels(Image &) { return false; }
+
+    private:
+        struct Size
+        {
+            int w, h;
+        };
+
+        FramePipeline &pipeline;
+        std::string label;
+        ResourcePool<Size, SDL_Texture, std::default_delete<Size>> textures;
+
+        RenderCommand &add(RenderCommand::Type type)
+        {
+            MemoryScope scope(MemoryTag::RENDER);
+            return pipeline.recording().add(type);
+        }
+    };
+
+} // namespace OWL
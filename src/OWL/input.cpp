@@ -27,7 +27,7 @@ namespace OWL
 
         //std::cout << inputText << std::endl;
         //Handle events on queue
-        while (SDL_PollEvent(&e) != 0)
+        while (pollEvent(&e) != 0)
         {
             //frameStart = SDL_GetTicks();
 
@@ -3,6 +3,7 @@
 
 #include <SDL2/SDL.h>
 #include <stdio.h>
+#include <functional>
 #include <memory>
 #include "msg.h"
 
@@ -22,18 +23,30 @@ namespace OWL
 
         ///Update is run every time the renderer updates the game window
         virtual void update();
+        /// Take events from source instead of SDL_PollEvent, e.g. when SDL's events are pumped on another thread.
+        void setEventSource(std::function<int(SDL_Event *)> source) { pollEvent = std::move(source); }
+        /// Switch SDL's text input through toggle instead of directly, e.g. when SDL belongs to another thread.
+        void setTextInputToggle(std::function<void(bool)> toggle) { textInputToggle = std::move(toggle); }
 
     protected:
         SDL_Event e;
+        std::function<int(SDL_Event *)> pollEvent{SDL_PollEvent};
+        std::function<void(bool)> textInputToggle{[](bool on) { on ? SDL_StartTextInput() : SDL_StopTextInput(); }};
         int lctrl{0}, rctrl{0};
         bool inputText{false};
 
-        void onNotify(OWL::Message msg)
+        void onNotify(const OWL::Message &msg)
         {
             if (msg.getParameter(0) == "inputTextEnable")
+            {
                 inputText = true;
+                textInputToggle(true);
+            }
             if (msg.getParameter(0) == "inputTextDisable")
+            {
                 inputText = false;
+                textInputToggle(false);
+            }
         }
     };
 } // namespace OWL
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "mixer.h"
+#include <string.h>
+#include <algorithm>
+#include "simd.h"
+
+#if defined(OWL_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(OWL_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace OWL
+{
+    //=== mixing kernels ==========================================================
+    // n counts floats, always even, so gains alternate L R starting from out[0]
+
+    static void mixSpanScalar(float *out, const float *in, int n, float gainL, float gainR)
+    {
+        for (int i = 0; i < n; i += 2)
+        {
+            out[i] += in[i] * gainL;
+            out[i + 1] += in[i + 1] * gainR;
+        }
+    }
+
+    static void masterSpanScalar(float *out, int n, float volume)
+    {
+        for (int i = 0; i < n; i++)
+            out[i] = std::min(std::max(out[i] * volume, -1.0f), 1.0f);
+    }
+
+#ifdef OWL_SIMD_SSE2
+    static void mixSpanSSE2(float *out, const float *in, int n, float gainL, float gainR)
+    {
+        const __m128 gain = _mm_setr_ps(gainL, gainR, gainL, gainR);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), gain)));
+        mixSpanScalar(out + i, in + i, n - i, gainL, gainR);
+    }
+
+    static void masterSpanSSE2(float *out, int n, float volume)
+    {
+        const __m128 v = _mm_set1_ps(volume), lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+        int i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(out + i), v), lo), hi));
+        masterSpanScalar(out + i, n - i, volume);
+    }
+#endif
+
+#ifdef OWL_SIMD_AVX2
+    __attribute__((target("avx2"))) static void mixSpanAVX2(float *out, const float *in, int n, float gainL, float gainR)
+    {
+        const __m256 gain = _mm256_setr_ps(gainL, gainR, gainL, gainR, gainL, gainR, gainL, gainR);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), gain)));
+        mixSpanScalar(out + i, in + i, n - i, gainL, gainR);
+    }
+
+    __attribute__((target("avx2"))) static void masterSpanAVX2(float *out, int n, float volume)
+    {
+        const __m256 v = _mm256_set1_ps(volume), lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f);
+        int i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(out + i), v), lo), hi));
+        masterSpanScalar(out + i, n - i, volume);
+    }
+#endif
+
+    static void mixSpan(float *out, const float *in, int n, float gainL, float gainR)
+    {
+        switch (simdLevel())
+        {
+#ifdef OWL_SIMD_AVX2
+        case SimdLevel::AVX2:
+            mixSpanAVX2(out, in, n, gainL, gainR);
+            return;
+#endif
+#ifdef OWL_SIMD_SSE2
+        case SimdLevel::SSE2:
+            mixSpanSSE2(out, in, n, gainL, gainR);
+            return;
+#endif
+        default:
+            mixSpanScalar(out, in, n, gainL, gainR);
+        }
+    }
+
+    static void masterSpan(float *out, int n, float volume)
+    {
+        switch (simdLevel())
+        {
+#ifdef OWL_SIMD_AVX2
+        case SimdLevel::AVX2:
+            masterSpanAVX2(out, n, volume);
+            return;
+#endif
+#ifdef OWL_SIMD_SSE2
+        case SimdLevel::SSE2:
+            masterSpanSSE2(out, n, volume);
+            return;
+#endif
+        default:
+            masterSpanScalar(out, n, volume);
+        }
+    }
+
+    //=== Mixer ===================================================================
+
+    Mixer::Mixer(int sampleRate, int maxVoices) : sampleRate{sampleRate}, maxVoices{maxVoices}
+    {
+        voices.reserve(maxVoices);
+    }
+
+    bool Mixer::push(const AudioCommand &command)
+    {
+        return commands.push(command);
+    }
+
+    // balance pan, so centered stereo sounds play at full volume on both sides
+    static void panGains(float volume, float pan, float &gainL, float &gainR)
+    {
+        pan = std::min(std::max(pan, -1.0f), 1.0f);
+        gainL = volume * (pan > 0.0f ? 1.0f - pan : 1.0f);
+        gainR = volume * (pan < 0.0f ? 1.0f + pan : 1.0f);
+    }
+
+    void Mixer::execute(const AudioCommand &command)
+    {
+        switch (command.type)
+        {
+        case AudioCommand::PLAY:
+        {
+            if ((int)voices.size() >= maxVoices || command.sample == nullptr || command.sample->frames == 0)
+            {
+                droppedVoices.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Voice voice{command.voice, command.sample, 0, 0.0f, 0.0f, command.loop};
+            panGains(command.volume, command.pan, voice.gainL, voice.gainR);
+            voices.push_back(voice);
+            return;
+        }
+        case AudioCommand::STOP:
+            for (size_t i = 0; i < voices.size(); i++)
+                if (voices[i].id == command.voice)
+                {
+                    voices[i] = voices.back();
+                    voices.pop_back();
+                    return;
+                }
+            return;
+        case AudioCommand::SET_GAIN:
+            for (auto &voice : voices)
+                if (voice.id == command.voice)
+                    panGains(command.volume, command.pan, voice.gainL, voice.gainR);
+            return;
+        case AudioCommand::STOP_ALL:
+            voices.clear();
+            return;
+        case AudioCommand::SET_MASTER:
+            masterVolume = command.volume;
+            return;
+        }
+    }
+
+    bool Mixer::mixVoice(Voice &voice, float *out, int frames)
+    {
+        const Sample &sample = *voice.sample;
+        int done = 0;
+        while (done < frames)
+        {
+            int n = std::min(frames - done, sample.frames - voice.position);
+            mixSpan(out + done * 2, sample.data.data() + voice.position * 2, n * 2, voice.gainL, voice.gainR);
+            voice.position += n;
+            done += n;
+            if (voice.position == sample.frames)
+            {
+                if (!voice.loop)
+                    return false;
+                voice.position = 0;
+            }
+        }
+        return true;
+    }
+
+    void Mixer::process(float *out, int frames)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t budget = (uint64_t)frames * 1000000000ull / sampleRate;
+        if (callbacks.load(std::memory_order_relaxed) > 0 &&
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(start - lastCallback).count() > 2 * budget)
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        lastCallback = start;
+
+        AudioCommand command;
+        while (commands.pop(command))
+            execute(command);
+
+        memset(out, 0, (size_t)frames * 2 * sizeof(float));
+        // finished voices are swap-removed, order doesn't matter for a sum
+        for (size_t i = 0; i < voices.size();)
+        {
+            if (mixVoice(voices[i], out, frames))
+                i++;
+            else
+            {
+                voices[i] = voices.back();
+                voices.pop_back();
+            }
+        }
+        masterSpan(out, frames * 2, masterVolume);
+
+        uint64_t took = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        if (took > budget)
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        lastNanos.store(took, std::memory_order_relaxed);
+        budgetNanos.store(budget, std::memory_order_relaxed);
+        totalNanos.fetch_add(took, std::memory_order_relaxed);
+        if (took > maxNanos.load(std::memory_order_relaxed))
+            maxNanos.store(took, std::memory_order_relaxed);
+        activeVoices.store((int)voices.size(), std::memory_order_relaxed);
+        callbacks.fetch_add(1, std::memory_order_release);
+    }
+
+    MixerStats Mixer::stats() const
+    {
+        MixerStats s;
+        s.callbacks = callbacks.load(std::memory_order_acquire);
+        s.lastMicros = lastNanos.load(std::memory_order_relaxed) / 1000.0;
+        s.averageMicros = s.callbacks > 0 ? totalNanos.load(std::memory_order_relaxed) / 1000.0 / s.callbacks : 0.0;
+        s.maxMicros = maxNanos.load(std::memory_order_relaxed) / 1000.0;
+        s.budgetMicros = budgetNanos.load(std::memory_order_relaxed) / 1000.0;
+        s.underruns = underruns.load(std::memory_order_relaxed);
+        s.voices = activeVoices.load(std::memory_order_relaxed);
+        s.droppedVoices = droppedVoices.load(std::memory_order_relaxed);
+        return s;
+    }
+
+} // namespace OWL
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "aligned.h"
+#include "pool.h"
+#include "spsc.h"
+
+namespace OWL
+{
+    /**
+     * @brief A decoded sound in the sample cache: interleaved stereo float frames at the mixer's rate.
+     */
+    struct Sample
+    {
+        AlignedArray<float> data; // frames * 2 floats, L R L R ...
+        int frames{0};
+    };
+
+    typedef Handle<Sample> SoundHandle;
+    /// Id of a playing voice, handed out by Audio::play(). 0 is no voice.
+    typedef uint32_t VoiceId;
+
+    /**
+     * @brief A request from the game thread to the mixer.
+     * @param volume,pan PLAY and SET_GAIN. SET_MASTER uses volume only.
+     * @param sample PLAY, must stay alive as long as the mixer can play it
+     */
+    struct AudioCommand
+    {
+        enum Type
+        {
+            PLAY,
+            STOP,
+            SET_GAIN,
+            STOP_ALL,
+            SET_MASTER
+        } type;
+        VoiceId voice;
+        const Sample *sample;
+        float volume;
+        float pan; // -1 left, 0 center, 1 right
+        bool loop;
+    };
+
+    struct MixerStats
+    {
+        uint64_t callbacks;
+        double lastMicros, averageMicros, maxMicros; // time spent in process()
+        double budgetMicros;                          // length of the last buffer
+        uint64_t underruns;
+        int voices;
+        uint64_t droppedVoices; // PLAY commands ignored because every voice was busy
+    };
+
+    /**
+     * @brief The audio thread's side of the sound system.
+     * @details The game thread only calls push(); commands travel through a lock-free
+     * SPSC queue and are applied at the start of the next process() call.
+     * process() runs in the audio callback: it never locks or allocates. It mixes every
+     * voice into the output with SIMD kernels (scalar, SSE2 or AVX2, see simd.h).
+     *
+     * An underrun is counted when a callback takes longer than the buffer it fills, or when
+     * more than two buffers' worth of time passes between callbacks.
+     *
+     * @param sampleRate output rate, only used for timing the buffers
+     * @param maxVoices voices that can play at once
+     */
+    class Mixer
+    {
+    public:
+        Mixer(int sampleRate, int maxVoices = 256);
+
+        /// Game thread. Returns false if the command queue is full.
+        bool push(const AudioCommand &command);
+        /// Audio thread. Fill out with frames interleaved stereo float frames.
+        void process(float *out, int frames);
+
+        /// Safe to call from any thread.
+        MixerStats stats() const;
+        int getSampleRate() const { return sampleRate; }
+
+    private:
+        struct Voice
+        {
+            VoiceId id;
+            const Sample *sample;
+            int position; // next frame to play
+            float gainL, gainR;
+            bool loop;
+        };
+
+        int sampleRate;
+        int maxVoices;
+        SpscQueue<AudioCommand, 1024> commands;
+        std::vector<Voice> voices; // playing voices, capacity reserved up front
+        float masterVolume{1.0f};
+        std::chrono::steady_clock::time_point lastCallback;
+
+        std::atomic<uint64_t> callbacks{0}, totalNanos{0}, lastNanos{0}, maxNanos{0}, budgetNanos{0};
+        std::atomic<uint64_t> underruns{0}, droppedVoices{0};
+        std::atomic<int> activeVoices{0};
+
+        void execute(const AudioCommand &command);
+        /// Mix frames of voice into out. Returns false when the voice has finished.
+        bool mixVoice(Voice &voice, float *out, int frames);
+    };
+
+} // namespace OWL
@@ -8,6 +8,9 @@
 #include <queue>
 #include <vector>
 #include <memory>
+#include "alloc.h"
+#include "clock.h"
+#include "timer_wheel.h"
 
 namespace OWL
 {
@@ -19,22 +22,25 @@ namespace OWL
     class Message
     {
     public:
-        Message(const std::vector<std::string> params)
-            : timestamp{SDL_GetTicks()}, messageParameters{params} {}
+        Message(std::vector<std::string> params)
+            : timestamp{ticks()}, messageParameters{std::move(params)} {}
+        /// Recreate a message with its original timestamp, e.g. from a save.
+        Message(std::vector<std::string> params, uint32_t timestamp)
+            : timestamp{timestamp}, messageParameters{std::move(params)} {}
 
-        uint32_t getTime()
+        uint32_t getTime() const
         {
             return timestamp;
         }
-        std::vector<std::string> getParameters()
+        const std::vector<std::string> &getParameters() const
         {
             return messageParameters;
         }
-        std::string getParameter(int i)
+        const std::string &getParameter(int i) const
         {
             return messageParameters[i];
         }
-        bool isCommand()
+        bool isCommand() const
         {
             char token = ':';
             if (messageParameters[0].at(0) == token)
@@ -52,11 +58,16 @@ namespace OWL
      * @brief A bus to store all messeges send by systems.
      * @details All components that can receive messages are added to the receivers vector.
      *          All messages MessageBus receives are stored in messages queue in FIFO order.
+     *
+     *          Messages can also be sent later or repeatedly on the tick clock. They wait in
+     *          a TimerWheel and join the queue when notify() finds them due, stamped with
+     *          the tick they were due at. Many due in the same notify() are queued in order
+     *          of due time, so a run on the manual clock delivers the same messages each time.
      */
     class MessageBus
     {
     public:
-        MessageBus() {}
+        MessageBus() : lastTicks{ticks()} {}
 
         /**
         * @brief Add a component to MessageBus's receivers.
@@ -68,7 +79,7 @@ namespace OWL
         * 
         * @param messageReceiver by default this is BusNode's getNotifyFunc(). 
         */
-        void addReceiver(std::function<void(Message)> messageReceiver)
+        void addReceiver(std::function<void(const Message &)> messageReceiver)
         {
             receivers.push_back(messageReceiver);
         }
@@ -80,13 +91,40 @@ namespace OWL
         */
         void sendMessage(Message msg)
         {
-            messages.push(msg);
             std::cout << msg.getParameter(0) << std::endl;
+            // the sender built msg under its own tag, the queue keeps a copy made under the bus's
+            MemoryScope scope(MemoryTag::BUS);
+            messages.push(Message(msg.getParameters(), msg.getTime()));
+        }
+
+        /// Send msg delayMs milliseconds of tick time from now. The handle can cancel it until then.
+        /// Returns a null handle, and msg is dropped, if too many timers are pending.
+        TimerHandle sendDelayed(Message msg, uint32_t delayMs)
+        {
+            advanceTimers();
+            // schedule takes its own copy of the parameters, made under the bus's tag
+            MemoryScope scope(MemoryTag::BUS);
+            return checkScheduled(timers.schedule(timers.now() + delayMs, msg.getParameters()), msg);
         }
 
+        /// Send msg every periodMs milliseconds of tick time, the first time periodMs from now, until it is cancelled.
+        /// Returns a null handle, and msg is dropped, if too many timers are pending.
+        TimerHandle sendEvery(Message msg, uint32_t periodMs)
+        {
+            advanceTimers();
+            periodMs = std::max(periodMs, 1u);
+            MemoryScope scope(MemoryTag::BUS);
+            return checkScheduled(timers.schedule(timers.now() + periodMs, msg.getParameters(), periodMs), msg);
+        }
+
+        /// Returns false if the message was already sent (and doesn't repeat) or cancelled before.
+        bool cancelTimer(TimerHandle timer) { return timers.cancel(timer); }
+        size_t pendingTimers() const { return timers.size(); }
+
         /// @brief Notify will send all the messages in the queue to the receivers. FIFO.
         void notify()
         {
+            advanceTimers();
             while (!messages.empty())
             {
                 for (auto iter = receivers.begin(); iter != receivers.end(); iter++)
@@ -94,12 +132,42 @@ namespace OWL
                     (*iter)(messages.front());
                 }
                 messages.pop();
+                delivered++;
             }
         }
 
+        /// Messages delivered so far.
+        uint64_t messageCount() const { return delivered; }
+
     private:
-        std::vector<std::function<void(Message)>> receivers;
+        std::vector<std::function<void(const Message &)>> receivers;
         std::queue<Message> messages;
+        uint64_t delivered{0};
+        TimerWheel<std::vector<std::string>> timers;
+        uint32_t lastTicks; // the tick clock when the timers were last advanced
+
+        TimerHandle checkScheduled(TimerHandle timer, const Message &msg)
+        {
+            if (!timer)
+                printf("MessageBus: too many timers (%zu pending), dropped %s\n", timers.size(), msg.getParameter(0).c_str());
+            return timer;
+        }
+
+        /// Bring the timers up to the tick clock and queue the messages due by now.
+        void advanceTimers()
+        {
+            uint32_t now = ticks();
+            uint32_t elapsed = now - lastTicks;
+            lastTicks = now;
+            // the clock only goes backwards when a run switches to the manual clock, timers wait then
+            if (elapsed > UINT32_MAX / 2)
+                return;
+            uint64_t target = timers.now() + elapsed;
+            MemoryScope scope(MemoryTag::BUS);
+            timers.advance(target, [this, now, target](const std::vector<std::string> &params, uint64_t due) {
+                messages.push(Message(params, now - (uint32_t)(target - due)));
+            });
+        }
     };
 
     /**
@@ -122,9 +190,9 @@ namespace OWL
         std::shared_ptr<MessageBus> messageBus = nullptr;
 
         /// add this object to the MessageBus receivers.
-        std::function<void(Message)> getNotifyFunc()
+        std::function<void(const Message &)> getNotifyFunc()
         {
-            auto messageListener = [=](Message msg) -> void {
+            auto messageListener = [=](const Message &msg) -> void {
                 this->onNotify(msg);
             };
             return messageListener;
@@ -132,11 +200,11 @@ namespace OWL
 
         void send(std::vector<std::string> params)
         {
-            messageBus->sendMessage(params);
+            messageBus->sendMessage(Message(std::move(params)));
         }
 
         // This is called when MessageBus sends messages out.
-        virtual void onNotify(Message msg) {}
+        virtual void onNotify(const Message &msg) {}
     };
 
 } // namespace OWL
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "particles.h"
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "blit.h"
+#include "draw.h"
+#include "simd.h"
+
+#if defined(OWL_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(OWL_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace OWL
+{
+    // SIMD paths run over whole vectors, so pools are padded to a multiple of this
+    static const size_t laneCount = 8;
+
+    ParticlePool::ParticlePool(size_t capacity)
+        : capacity{capacity}, x{capacity}, y{capacity}, vx{capacity}, vy{capacity}, life{capacity},
+          invLifetime{capacity}, fade{capacity}, size{capacity}, color{capacity} {}
+
+    bool ParticlePool::isValid() const
+    {
+        return x.data() && y.data() && vx.data() && vy.data() && life.data() && invLifetime.data() && fade.data() &&
+               size.data() && color.data();
+    }
+
+    //=== update kernels ==========================================================
+    // All versions do the same float operations in the same order (no FMA),
+    // so they give identical results.
+
+    struct KernelArgs
+    {
+        float *x, *y, *vx, *vy, *life;
+        const float *invLifetime;
+        float *fade;
+        size_t n; // multiple of laneCount
+        float dt, gx, gy;
+    };
+
+    static void integrateScalar(const KernelArgs &k)
+    {
+        for (size_t i = 0; i < k.n; i++)
+        {
+            k.vx[i] = k.vx[i] + k.gx * k.dt;
+            k.vy[i] = k.vy[i] + k.gy * k.dt;
+            k.x[i] = k.x[i] + k.vx[i] * k.dt;
+            k.y[i] = k.y[i] + k.vy[i] * k.dt;
+            k.life[i] = k.life[i] - k.dt;
+            k.fade[i] = std::max(k.life[i] * k.invLifetime[i], 0.0f);
+        }
+    }
+
+#ifdef OWL_SIMD_SSE2
+    static void integrateSSE2(const KernelArgs &k)
+    {
+        const __m128 dt = _mm_set1_ps(k.dt);
+        const __m128 gdx = _mm_set1_ps(k.gx * k.dt), gdy = _mm_set1_ps(k.gy * k.dt);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < k.n; i += 4)
+        {
+            __m128 vx = _mm_add_ps(_mm_load_ps(k.vx + i), gdx);
+            __m128 vy = _mm_add_ps(_mm_load_ps(k.vy + i), gdy);
+            _mm_store_ps(k.vx + i, vx);
+            _mm_store_ps(k.vy + i, vy);
+            _mm_store_ps(k.x + i, _mm_add_ps(_mm_load_ps(k.x + i), _mm_mul_ps(vx, dt)));
+            _mm_store_ps(k.y + i, _mm_add_ps(_mm_load_ps(k.y + i), _mm_mul_ps(vy, dt)));
+            __m128 life = _mm_sub_ps(_mm_load_ps(k.life + i), dt);
+            _mm_store_ps(k.life + i, life);
+            _mm_store_ps(k.fade + i, _mm_max_ps(_mm_mul_ps(life, _mm_load_ps(k.invLifetime + i)), zero));
+        }
+    }
+#endif
+
+#ifdef OWL_SIMD_AVX2
+    __attribute__((target("avx2"))) static void integrateAVX2(const KernelArgs &k)
+    {
+        const __m256 dt = _mm256_set1_ps(k.dt);
+        const __m256 gdx = _mm256_set1_ps(k.gx * k.dt), gdy = _mm256_set1_ps(k.gy * k.dt);
+        const __m256 zero = _mm256_setzero_ps();
+        for (size_t i = 0; i < k.n; i += 8)
+        {
+            __m256 vx = _mm256_add_ps(_mm256_load_ps(k.vx + i), gdx);
+            __m256 vy = _mm256_add_ps(_mm256_load_ps(k.vy + i), gdy);
+            _mm256_store_ps(k.vx + i, vx);
+            _mm256_store_ps(k.vy + i, vy);
+            _mm256_store_ps(k.x + i, _mm256_add_ps(_mm256_load_ps(k.x + i), _mm256_mul_ps(vx, dt)));
+            _mm256_store_ps(k.y + i, _mm256_add_ps(_mm256_load_ps(k.y + i), _mm256_mul_ps(vy, dt)));
+            __m256 life = _mm256_sub_ps(_mm256_load_ps(k.life + i), dt);
+            _mm256_store_ps(k.life + i, life);
+            _mm256_store_ps(k.fade + i, _mm256_max_ps(_mm256_mul_ps(life, _mm256_load_ps(k.invLifetime + i)), zero));
+        }
+    }
+#endif
+
+    static void integrate(const KernelArgs &k)
+    {
+        switch (simdLevel())
+        {
+#ifdef OWL_SIMD_AVX2
+        case SimdLevel::AVX2:
+            integrateAVX2(k);
+            return;
+#endif
+#ifdef OWL_SIMD_SSE2
+        case SimdLevel::SSE2:
+            integrateSSE2(k);
+            return;
+#endif
+        default:
+            integrateScalar(k);
+        }
+    }
+
+    //=== ParticleSystem ==========================================================
+
+    ParticleSystem::ParticleSystem(size_t capacity, uint32_t seed)
+        : capacity{(capacity + laneCount - 1) / laneCount * laneCount}, rng{seed ? seed : 1} {}
+
+    int ParticleSystem::addEmitter(const Emitter &emitter, TextureHandle texture)
+    {
+        size_t layer = 0;
+        while (layer < layers.size() && layers[layer].texture != texture)
+            layer++;
+        if (layer == layers.size())
+        {
+            layers.emplace_back(texture, capacity);
+            if (!layers.back().pool.isValid())
+            {
+                printf("Unable to allocate a pool of %zu particles!\n", capacity);
+                layers.pop_back();
+                return -1;
+            }
+        }
+        emitters.push_back({emitter, layer});
+        return (int)emitters.size() - 1;
+    }
+
+    void ParticleSystem::burst(int id, int count)
+    {
+        spawn(emitters[id], count);
+    }
+
+    void ParticleSystem::setGravity(float x, float y)
+    {
+        gravityX = x;
+        gravityY = y;
+    }
+
+    float ParticleSystem::random01()
+    {
+        // xorshift32
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return (rng >> 8) * (1.0f / 16777216.0f);
+    }
+
+    void ParticleSystem::spawn(EmitterState &emitter, int count)
+    {
+        const Emitter &e = emitter.settings;
+        ParticlePool &p = layers[emitter.layer].pool;
+        uint32_t color = blit::packColor(e.color);
+        for (int n = 0; n < count && p.count < p.capacity; n++)
+        {
+            size_t i = p.count++;
+            float angle = e.direction + (random01() - 0.5f) * e.spread;
+            float speed = e.speedMin + random01() * (e.speedMax - e.speedMin);
+            float lifetime = e.lifetimeMin + random01() * (e.lifetimeMax - e.lifetimeMin);
+            p.x[i] = e.x;
+            p.y[i] = e.y;
+            p.vx[i] = cosf(angle) * speed;
+            p.vy[i] = sinf(angle) * speed;
+            p.life[i] = lifetime;
+            p.invLifetime[i] = lifetime > 0.0f ? 1.0f / lifetime : 0.0f;
+            p.fade[i] = 1.0f;
+            p.size[i] = e.size;
+            p.color[i] = color;
+        }
+    }
+
+    void ParticleSystem::update(float dt)
+    {
+        for (auto &layer : layers)
+        {
+            ParticlePool &p = layer.pool;
+            if (p.count == 0)
+                continue;
+            KernelArgs k = {p.x.data(), p.y.data(), p.vx.data(), p.vy.data(), p.life.data(), p.invLifetime.data(),
+                            p.fade.data(), (p.count + laneCount - 1) / laneCount * laneCount, dt, gravityX, gravityY};
+            integrate(k);
+
+            // swap-remove the dead, order doesn't matter
+            size_t i = 0, n = p.count;
+            while (i < n)
+            {
+                if (p.life[i] > 0.0f)
+                {
+                    i++;
+                    continue;
+                }
+                n--;
+                p.x[i] = p.x[n], p.y[i] = p.y[n], p.vx[i] = p.vx[n], p.vy[i] = p.vy[n];
+                p.life[i] = p.life[n], p.invLifetime[i] = p.invLifetime[n], p.fade[i] = p.fade[n];
+                p.size[i] = p.size[n], p.color[i] = p.color[n];
+            }
+            p.count = n;
+        }
+
+        for (auto &emitter : emitters)
+        {
+            if (!emitter.settings.active)
+                continue;
+            emitter.carry += emitter.settings.rate * dt;
+            int count = (int)emitter.carry;
+            emitter.carry -= count;
+            spawn(emitter, count);
+        }
+    }
+
+    const std::vector<Sprite> &ParticleSystem::buildBatch(size_t layer)
+    {
+        const ParticlePool &p = layers[layer].pool;
+        batch.resize(p.count);
+        for (size_t i = 0; i < p.count; i++)
+        {
+            float s = p.size[i];
+            uint32_t c = p.color[i];
+            Sprite &sprite = batch[i];
+            sprite.dst = {p.x[i] - s * 0.5f, p.y[i] - s * 0.5f, s, s};
+            sprite.src = {0, 0, 0, 0};
+            sprite.color = {(Uint8)c, (Uint8)(c >> 8), (Uint8)(c >> 16), (Uint8)((c >> 24) * p.fade[i])};
+        }
+        return batch;
+    }
+
+    void ParticleSystem::render(Draw &draw)
+    {
+        for (size_t layer = 0; layer < layers.size(); layer++)
+        {
+            if (layers[layer].pool.count == 0)
+                continue;
+            buildBatch(layer);
+            draw.drawSprites(layers[layer].texture, batch.data(), (int)batch.size());
+        }
+    }
+
+    size_t ParticleSystem::liveCount() const
+    {
+        size_t total = 0;
+        for (const auto &layer : layers)
+            total += layer.pool.count;
+        return total;
+    }
+
+} // namespace OWL
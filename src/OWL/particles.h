@@ -0,0 +1,114 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vector>
+#include "aligned.h"
+#include "backend.h"
+#include "pool.h"
+
+namespace OWL
+{
+    class Draw;
+
+    /**
+     * @brief Settings of a particle emitter.
+     * @param x,y where particles spawn, in screen coordinates
+     * @param rate particles per second
+     * @param direction,spread launch angle and the random spread around it, in radians
+     * @param speedMin,speedMax launch speed range, pixels per second
+     * @param lifetimeMin,lifetimeMax lifetime range, seconds
+     * @param size quad size in pixels
+     * @param color starting color. Alpha fades out to 0 over the lifetime.
+     */
+    struct Emitter
+    {
+        float x{0}, y{0};
+        float rate{100};
+        float direction{0}, spread{6.2831853f};
+        float speedMin{20}, speedMax{60};
+        float lifetimeMin{0.5f}, lifetimeMax{1.5f};
+        float size{2};
+        SDL_Color color{255, 175, 46, 255};
+        bool active{true};
+    };
+
+    /**
+     * @brief Struct-of-arrays particle storage. Every field lives in its own aligned array.
+     * @details If the arrays can't be allocated, isValid() is false and the pool must not be used.
+     */
+    struct ParticlePool
+    {
+        explicit ParticlePool(size_t capacity);
+
+        bool isValid() const;
+
+        size_t count{0};
+        size_t capacity;
+        AlignedArray<float> x, y, vx, vy;
+        AlignedArray<float> life;        // seconds left
+        AlignedArray<float> invLifetime; // 1 / starting lifetime
+        AlignedArray<float> fade;        // life / lifetime, written by the update kernel
+        AlignedArray<float> size;
+        AlignedArray<uint32_t> color; // RGBA32
+    };
+
+    /**
+     * @brief Particle effects: emitters feed SoA particle pools, one pool per texture.
+     * @details update() integrates all particles with a SIMD kernel (velocity, position,
+     * lifetime and fade in one pass), then compacts dead particles away by swap-remove.
+     * render() turns each pool into one sprite batch, so each texture costs a single
+     * drawSprites call no matter how many particles it has.
+     * Spawning uses its own xorshift generator, so a given seed always plays out the same.
+     *
+     * @param capacity maximum live particles per texture
+     * @param seed random seed
+     */
+    class ParticleSystem
+    {
+    public:
+        ParticleSystem(size_t capacity = 1 << 14, uint32_t seed = 0x2545F491);
+
+        /// Add an emitter drawing with texture (a null handle draws solid squares). Returns its id,
+        /// or -1 if the particle pool of a new texture can't be allocated.
+        int addEmitter(const Emitter &emitter, TextureHandle texture = TextureHandle());
+        Emitter &getEmitter(int id) { return emitters[id].settings; }
+        /// Spawn count particles from an emitter right away.
+        void burst(int id, int count);
+        void setGravity(float x, float y);
+
+        /// Advance the simulation by dt seconds.
+        void update(float dt);
+        void render(Draw &draw);
+        /// Fill the sprite batch of one texture layer, as render() does before submitting it.
+        const std::vector<Sprite> &buildBatch(size_t layer);
+
+        size_t layerCount() const { return layers.size(); }
+        size_t liveCount() const;
+
+    private:
+        struct EmitterState
+        {
+            Emitter settings;
+            size_t layer;      // index into layers
+            float carry{0.0f}; // fractional particles left over from the last update
+        };
+        struct Layer
+        {
+            Layer(TextureHandle texture, size_t capacity) : texture{texture}, pool{capacity} {}
+            TextureHandle texture;
+            ParticlePool pool;
+        };
+
+        size_t capacity;
+        std::vector<EmitterState> emitters;
+        std::vector<Layer> layers;
+        std::vector<Sprite> batch; // reused sprite batch
+        float gravityX{0.0f}, gravityY{0.0f};
+        uint32_t rng;
+
+        void spawn(EmitterState &emitter, int count);
+        float random01();
+    };
+
+} // namespace OWL
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "utils.h"
+
+namespace OWL
+{
+    /**
+     * @brief 32-bit generational handle to a resource stored in a ResourcePool.
+     * @details The low 20 bits are the slot index and the high 12 bits the generation
+     * of that slot. Generation 0 is never handed out, so a zero handle is always invalid.
+     * Handles are typed, so a texture handle can't be passed where a surface is expected.
+     */
+    template <typename T>
+    struct Handle
+    {
+        static const uint32_t indexBits = 20;
+        static const uint32_t indexMask = (1u << indexBits) - 1;
+        static const uint32_t generationMask = (1u << (32 - indexBits)) - 1;
+
+        uint32_t value{0};
+
+        uint32_t index() const { return value & indexMask; }
+        uint32_t generation() const { return value >> indexBits; }
+        bool isNull() const { return value == 0; }
+        explicit operator bool() const { return value != 0; }
+        bool operator==(Handle other) const { return value == other.value; }
+        bool operator!=(Handle other) const { return value != other.value; }
+
+        static Handle make(uint32_t index, uint32_t generation)
+        {
+            Handle h;
+            h.value = (generation << indexBits) | (index & indexMask);
+            return h;
+        }
+    };
+
+    /// Default ResourcePool deleter, frees SDL resources with the matching SDL_DelRes.
+    struct SdlDeleter
+    {
+        template <typename T>
+        void operator()(T *t) const { SDL_DelRes(t); }
+    };
+
+    /**
+     * @brief Owning pool of resources addressed by generational handles.
+     * @details Resources live in a dense slot array. Released slots go to a free list
+     * and their generation is bumped, so old handles to them become stale.
+     * A stale handle resolves to nullptr; debug builds also report and assert on it.
+     * The pool destroys every live resource with Deleter when it is destroyed.
+     *
+     * @tparam T stored resource type
+     * @tparam Tag handle type, so pools of different storage types can share one kind of handle
+     * @tparam Deleter functor that frees a T*
+     */
+    template <typename T, typename Tag = T, typename Deleter = SdlDeleter>
+    class ResourcePool
+    {
+    public:
+        ResourcePool() {}
+        ~ResourcePool() { clear(); }
+        ResourcePool(const ResourcePool &) = delete;
+        ResourcePool &operator=(const ResourcePool &) = delete;
+
+        /**
+         * @brief Take ownership of a resource. Returns a null handle if resource is NULL.
+         * @details If every index a handle can hold is in use, the resource is destroyed
+         * and a null handle returned, in release builds too.
+         */
+        Handle<Tag> add(T *resource)
+        {
+            if (resource == nullptr)
+                return Handle<Tag>();
+
+            uint32_t index;
+            if (!freeList.empty())
+            {
+                index = freeList.back();
+                freeList.pop_back();
+            }
+            else
+            {
+                index = static_cast<uint32_t>(resources.size());
+                if (index > Handle<Tag>::indexMask)
+                {
+                    printf("ResourcePool: full (%u slots)\n", index);
+                    Deleter()(resource);
+                    return Handle<Tag>();
+                }
+                resources.push_back(nullptr);
+                generations.push_back(1);
+            }
+            resources[index] = resource;
+            live++;
+            return Handle<Tag>::make(index, generations[index]);
+        }
+
+        /// Get the raw resource, or nullptr if the handle is null or stale.
+        T *get(Handle<Tag> h) const
+        {
+            if (h.isNull())
+                return nullptr;
+            uint32_t i = h.index();
+            if (i >= resources.size() || generations[i] != h.generation())
+            {
+                reportStale(h);
+                return nullptr;
+            }
+            return resources[i];
+        }
+
+        bool isValid(Handle<Tag> h) const
+        {
+            uint32_t i = h.index();
+            return !h.isNull() && i < resources.size() && generations[i] == h.generation();
+        }
+
+        /// Destroy the resource and recycle its slot. Releasing a null handle does nothing.
+        void release(Handle<Tag> h)
+        {
+            T *resource = get(h);
+            if (resource == nullptr)
+                return;
+            uint32_t i = h.index();
+            Deleter()(resource);
+            resources[i] = nullptr;
+            // skip generation 0 on wrap-around so the null handle stays unique
+            generations[i] = (generations[i] + 1) & Handle<Tag>::generationMask;
+            if (generations[i] == 0)
+                generations[i] = 1;
+            freeList.push_back(i);
+            live--;
+        }
+
+        /// Destroy all resources. Every outstanding handle becomes stale.
+        void clear()
+        {
+            for (uint32_t i = 0; i < resources.size(); i++)
+                if (resources[i] != nullptr)
+                    release(Handle<Tag>::make(i, generations[i]));
+        }
+
+        size_t size() const { return live; }
+        size_t capacity() const { return resources.size(); }
+
+    private:
+        std::vector<T *> resources;        // dense slot storage
+        std::vector<uint32_t> generations; // current generation of every slot
+        std::vector<uint32_t> freeList;    // released slot indices, reused LIFO
+        size_t live{0};
+
+        void reportStale(Handle<Tag> h) const
+        {
+#ifndef NDEBUG
+            printf("ResourcePool: stale handle (index %u, generation %u)\n", h.index(), h.generation());
+            assert(!"stale ResourcePool handle");
+#endif
+        }
+    };
+
+    typedef Handle<SDL_Texture> TextureHandle;
+    typedef Handle<SDL_Surface> SurfaceHandle;
+
+} // namespace OWL
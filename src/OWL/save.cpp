@@ -0,0 +1,255 @@
+#include "save.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include "alloc.h"
+
+namespace OWL
+{
+    SaveSystem::SaveSystem(std::shared_ptr<MessageBus> msgBus, std::string directory, uint32_t autosaveInterval)
+        : BusNode(msgBus, "SaveSystem"), directory{directory}, autosaveInterval{autosaveInterval}
+    {
+        if (autosaveInterval > 0)
+            nextAutosave = messageBus->sendDelayed(Message({":autosave"}), autosaveInterval);
+        mkdir(directory.c_str(), 0755);
+        worker = std::thread(&SaveSystem::run, this);
+    }
+
+    SaveSystem::~SaveSystem()
+    {
+        messageBus->cancelTimer(nextAutosave);
+        // queued saves are still written before the thread exits
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void SaveSystem::addSection(uint32_t id, CowBuffer &buffer, std::function<void()> prepare, std::function<void()> loaded)
+    {
+        sections.push_back({id, &buffer, prepare, loaded});
+    }
+
+    bool SaveSystem::isValidName(const std::string &name)
+    {
+        if (name.empty() || name.size() > 64)
+            return false;
+        for (char c : name)
+            if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-'))
+                return false;
+        return true;
+    }
+
+    std::string SaveSystem::pathFor(const std::string &name) const
+    {
+        return directory + "/" + name + ".owls";
+    }
+
+    SnapshotCapture SaveSystem::capture(const std::string &path, bool delta)
+    {
+        auto start = std::chrono::steady_clock::now();
+        SnapshotCapture snapshot;
+        snapshot.path = path;
+        snapshot.delta = delta;
+        snapshot.sequence = ++sequence;
+        for (auto &section : sections)
+            snapshot.sections.push_back(captureSection(section.id, *section.buffer, delta));
+        captureMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        return snapshot;
+    }
+
+    void SaveSystem::save(const std::string &name)
+    {
+        MemoryScope scope(MemoryTag::SAVE);
+        if (!isValidName(name))
+        {
+            send({"save failed: invalid name " + name});
+            return;
+        }
+        for (auto &section : sections)
+            if (section.prepare)
+                section.prepare();
+        SnapshotCapture snapshot = capture(pathFor(name), false);
+        enqueue({std::move(snapshot), false, captureMicros});
+    }
+
+    void SaveSystem::autosave()
+    {
+        MemoryScope scope(MemoryTag::SAVE);
+        if (autosaveInterval > 0)
+        {
+            messageBus->cancelTimer(nextAutosave);
+            nextAutosave = messageBus->sendDelayed(Message({":autosave"}), autosaveInterval);
+        }
+        size_t total = 0, dirty = 0;
+        for (auto &section : sections)
+        {
+            if (section.prepare)
+                section.prepare();
+            total += section.buffer->chunkCount();
+            dirty += section.buffer->dirtyCount();
+        }
+        if (haveBase && dirty == 0)
+            return;
+
+        if (!haveBase || dirty * 2 > total)
+        {
+            SnapshotCapture snapshot = capture(pathFor("autosave.base"), false);
+            // the delta restarts from this base
+            for (auto &section : sections)
+                section.buffer->clearDirty();
+            haveBase = true;
+            enqueue({std::move(snapshot), true, captureMicros});
+        }
+        else
+        {
+            SnapshotCapture snapshot = capture(pathFor("autosave.delta"), true);
+            enqueue({std::move(snapshot), false, captureMicros});
+        }
+    }
+
+    void SaveSystem::enqueue(Job job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    void SaveSystem::run()
+    {
+        MemoryScope scope(MemoryTag::SAVE);
+#ifdef __linux__
+        // only use CPU time the game leaves over, so a big save can't push a frame late
+        sched_param priority{0};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &priority);
+#endif
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            writing = true;
+            if (job.capture.delta)
+                job.capture.baseChecksum = baseChecksum;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            uint64_t checksum = 0;
+            size_t chunks = 0;
+            for (const auto &section : job.capture.sections)
+                chunks += section.chunks.size();
+            if (!job.capture.delta || job.capture.baseChecksum != 0)
+                checksum = writeSnapshot(job.capture);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (job.base)
+                // a delta next to a new base is stale, don't let anything load it
+                remove(pathFor("autosave.delta").c_str());
+
+            char line[256];
+            if (checksum != 0)
+                snprintf(line, sizeof(line), "saved %s: %s, %zu chunks, %.2f MB in %.1f ms (capture %.0f us)",
+                         job.capture.path.c_str(), job.capture.delta ? "delta" : "full", chunks,
+                         chunks * snapshot::chunkSize / 1048576.0, ms, job.captureMicros);
+            else
+                snprintf(line, sizeof(line), "save failed: %s", job.capture.path.c_str());
+
+            lock.lock();
+            if (job.base)
+                baseChecksum = checksum;
+            if ((job.base || job.capture.delta) && checksum == 0)
+                baseFailed = true;
+            results.push_back(line);
+            writing = false;
+            if (jobs.empty())
+                idle.notify_all();
+        }
+    }
+
+    void SaveSystem::flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return jobs.empty() && !writing; });
+    }
+
+    bool SaveSystem::load(const std::string &name)
+    {
+        MemoryScope scope(MemoryTag::SAVE);
+        if (!isValidName(name))
+        {
+            send({"load failed: invalid name " + name});
+            return false;
+        }
+        flush();
+        std::shared_ptr<SnapshotFile> base, delta;
+        if (name == "autosave")
+        {
+            base = SnapshotFile::open(pathFor("autosave.base"));
+            delta = SnapshotFile::open(pathFor("autosave.delta"));
+            if (base != nullptr && delta != nullptr &&
+                (!delta->isDelta() || delta->header().baseChecksum != base->header().checksum))
+                delta = nullptr;
+        }
+        else
+            base = SnapshotFile::open(pathFor(name));
+        if (base == nullptr || base->isDelta())
+        {
+            send({"load failed: no valid snapshot " + name});
+            return false;
+        }
+
+        for (auto &section : sections)
+        {
+            base->apply(section.id, *section.buffer);
+            if (delta != nullptr)
+                delta->apply(section.id, *section.buffer);
+            if (section.loaded)
+                section.loaded();
+        }
+        sequence = std::max(sequence, (delta != nullptr ? delta : base)->header().sequence);
+
+        // loading the autosave continues its delta chain, anything else needs a new base
+        haveBase = name == "autosave";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            baseChecksum = haveBase ? base->header().checksum : 0;
+        }
+        send({"loaded " + name + (delta != nullptr ? " (base + delta)" : "")});
+        return true;
+    }
+
+    void SaveSystem::update()
+    {
+        std::vector<std::string> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.swap(results);
+        }
+        for (auto &line : finished)
+            send({line});
+        // the dirty chunks since the failed base are gone, so start over from a full one
+        if (baseFailed.exchange(false))
+            haveBase = false;
+    }
+
+    void SaveSystem::onNotify(const Message &msg)
+    {
+        const std::string &text = msg.getParameter(0);
+        if (text == ":autosave")
+            autosave();
+        else if (text == ":save" || text.compare(0, 6, ":save ") == 0)
+            save(text.size() > 6 ? text.substr(6) : "quicksave");
+        else if (text == ":load" || text.compare(0, 6, ":load ") == 0)
+            load(text.size() > 6 ? text.substr(6) : "quicksave");
+    }
+
+} // namespace OWL
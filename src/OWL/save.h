@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "msg.h"
+#include "snapshot.h"
+
+namespace OWL
+{
+    /**
+     * @brief Saves and loads game state as snapshot files (see snapshot.h).
+     * @details Game state lives in CowBuffers registered as sections. Saving only
+     * captures their chunk pointers on the game thread. A background thread writes the
+     * file, so even a big map doesn't hitch a frame.
+     *
+     * Autosaves are a full base snapshot (autosave.base) plus one delta (autosave.delta).
+     * The delta holds every chunk changed since the base was taken. Once that is more
+     * than half of the state, the next autosave writes a new base instead.
+     *
+     * Console commands: ":save [name]", ":load [name]" and ":autosave".
+     * Loading "autosave" loads the base and applies the delta. The interval is kept with a
+     * delayed ":autosave" message, restarted by every autosave.
+     *
+     * @param directory where snapshot files go, created if missing
+     * @param autosaveInterval milliseconds of tick time between autosaves, 0 to turn them off
+     */
+    class SaveSystem : public BusNode
+    {
+    public:
+        SaveSystem(std::shared_ptr<MessageBus> msgBus, std::string directory = "saves", uint32_t autosaveInterval = 60000);
+        ~SaveSystem();
+
+        /**
+         * @brief Register state to save.
+         * @param prepare runs on the game thread right before every capture, to write pending state into buffer
+         * @param loaded runs after a load replaced the contents of buffer
+         */
+        void addSection(uint32_t id, CowBuffer &buffer, std::function<void()> prepare = nullptr, std::function<void()> loaded = nullptr);
+
+        /// Full snapshot to <directory>/<name>.owls, written in the background. Refuses names that aren't isValidName().
+        void save(const std::string &name);
+        void autosave();
+        /// Waits for pending writes, then loads. Returns false if the name isn't valid or nothing valid was found.
+        bool load(const std::string &name);
+        /// Save names are 1 to 64 of A-Z, a-z, 0-9, '_' and '-', so they can't leave the save directory.
+        static bool isValidName(const std::string &name);
+        /// Block until every queued write is on disk.
+        void flush();
+
+        /// Report finished writes.
+        void update();
+
+        /// Game thread time of the last capture, in microseconds.
+        double lastCaptureMicros() const { return captureMicros; }
+
+    private:
+        struct Section
+        {
+            uint32_t id;
+            CowBuffer *buffer;
+            std::function<void()> prepare, loaded;
+        };
+        struct Job
+        {
+            SnapshotCapture capture;
+            bool base; // an autosave base: deltas after it refer to its checksum
+            double captureMicros;
+        };
+
+        std::string directory;
+        uint32_t autosaveInterval;
+        TimerHandle nextAutosave;
+        std::vector<Section> sections;
+        uint64_t sequence{0};
+        bool haveBase{false}; // an autosave base has been captured since the last load
+        double captureMicros{0};
+
+        // background writer, everything below is guarded by mutex
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable wake, idle;
+        std::deque<Job> jobs;
+        bool writing{false};
+        bool quit{false};
+        uint64_t baseChecksum{0};         // checksum of the autosave base on disk, 0 if it failed
+        std::vector<std::string> results; // reports for the game thread to send
+        std::atomic<bool> baseFailed{false};
+
+        std::string pathFor(const std::string &name) const;
+        /// Capture every section, whole or only its dirty chunks. Run the prepare callbacks first.
+        SnapshotCapture capture(const std::string &path, bool delta);
+        void enqueue(Job job);
+        void run();
+
+        void onNotify(const Message &msg);
+    };
+
+} // namespace OWL
@@ -29,7 +29,7 @@ namespace OWL
         // if a new viewport is not created here, the borders will appear around latest viewport that has been created
         if (borders)
         {
-            draw->createViewport(texture.get(), x, y, w, h);
+            draw->createViewport(texture, x, y, w, h);
             draw->drawBox(x, y, w, h, foreground, borderWidth);
         }
     }
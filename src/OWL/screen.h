@@ -30,7 +30,7 @@ namespace OWL
 
     protected:
         std::shared_ptr<Draw> draw{nullptr};
-        std::shared_ptr<SDL_Texture> texture{nullptr};
+        TextureHandle texture;
         SDL_Color foreground{255, 175, 46, 255};
         SDL_Color background{0, 0, 0, 255};
         bool borders;
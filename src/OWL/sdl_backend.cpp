@@ -0,0 +1,125 @@
+#include "sdl_backend.h"
+
+namespace OWL
+{
+    SdlBackend::SdlBackend(SDL_Window *window)
+        : renderer{sdl_shared(SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC))}
+    {
+        if (renderer == nullptr)
+            printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+    }
+
+    TextureHandle SdlBackend::createTexture(int w, int h)
+    {
+        return textures.add(SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h));
+    }
+
+    TextureHandle SdlBackend::createTextureFromSurface(SDL_Surface *surface)
+    {
+        return textures.add(SDL_CreateTextureFromSurface(renderer.get(), surface));
+    }
+
+    void SdlBackend::queryTexture(TextureHandle texture, int *w, int *h)
+    {
+        SDL_QueryTexture(textures.get(texture), NULL, NULL, w, h);
+    }
+
+    void SdlBackend::setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode)
+    {
+        SDL_SetTextureBlendMode(textures.get(texture), mode);
+    }
+
+    void SdlBackend::setTarget(TextureHandle texture)
+    {
+        SDL_SetRenderTarget(renderer.get(), textures.get(texture));
+    }
+
+    void SdlBackend::setViewport(const SDL_Rect *rect)
+    {
+        SDL_RenderSetViewport(renderer.get(), rect);
+    }
+
+    void SdlBackend::setScale(float scaleX, float scaleY)
+    {
+        SDL_RenderSetScale(renderer.get(), scaleX, scaleY);
+    }
+
+    void SdlBackend::setDrawColor(SDL_Color color)
+    {
+        SDL_SetRenderDrawColor(renderer.get(), color.r, color.g, color.b, color.a);
+    }
+
+    void SdlBackend::setDrawBlendMode(SDL_BlendMode mode)
+    {
+        SDL_SetRenderDrawBlendMode(renderer.get(), mode);
+    }
+
+    void SdlBackend::clear()
+    {
+        SDL_RenderClear(renderer.get());
+    }
+
+    void SdlBackend::fillRect(const SDL_Rect *rect)
+    {
+        SDL_RenderFillRect(renderer.get(), rect);
+    }
+
+    void SdlBackend::drawLines(const SDL_Point *points, int count)
+    {
+        SDL_RenderDrawLines(renderer.get(), points, count);
+    }
+
+    void SdlBackend::copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                          double angle, const SDL_Point *center, SDL_RendererFlip flip)
+    {
+        SDL_RenderCopyEx(renderer.get(), textures.get(texture), src, dst, angle, center, flip);
+    }
+
+    void SdlBackend::drawSprites(TextureHandle texture, const Sprite *sprites, int count)
+    {
+        SDL_Texture *t = textures.get(texture);
+        int tw = 1, th = 1;
+        if (t != nullptr)
+            SDL_QueryTexture(t, NULL, NULL, &tw, &th);
+
+        vertices.resize((size_t)count * 4);
+        indices.resize((size_t)count * 6);
+        for (int i = 0; i < count; i++)
+        {
+            const Sprite &s = sprites[i];
+            SDL_Rect src = s.src.w > 0 ? s.src : SDL_Rect{0, 0, tw, th};
+            float u0 = (float)src.x / tw, v0 = (float)src.y / th;
+            float u1 = (float)(src.x + src.w) / tw, v1 = (float)(src.y + src.h) / th;
+            SDL_Vertex *v = &vertices[(size_t)i * 4];
+            v[0] = {{s.dst.x, s.dst.y}, s.color, {u0, v0}};
+            v[1] = {{s.dst.x + s.dst.w, s.dst.y}, s.color, {u1, v0}};
+            v[2] = {{s.dst.x + s.dst.w, s.dst.y + s.dst.h}, s.color, {u1, v1}};
+            v[3] = {{s.dst.x, s.dst.y + s.dst.h}, s.color, {u0, v1}};
+            int *idx = &indices[(size_t)i * 6];
+            int base = i * 4;
+            idx[0] = base, idx[1] = base + 1, idx[2] = base + 2;
+            idx[3] = base, idx[4] = base + 2, idx[5] = base + 3;
+        }
+        SDL_RenderGeometry(renderer.get(), t, vertices.data(), count * 4, indices.data(), count * 6);
+    }
+
+    void SdlBackend::present()
+    {
+        SDL_RenderPresent(renderer.get());
+    }
+
+    bool SdlBackend::readPixels(Image &image)
+    {
+        // reading with a NULL rect reads the viewport, so widen it to the whole screen first
+        SDL_RenderSetViewport(renderer.get(), NULL);
+        SDL_GetRendererOutputSize(renderer.get(), &image.w, &image.h);
+        image.pixels.resize((size_t)image.w * image.h);
+        if (SDL_RenderReadPixels(renderer.get(), NULL, SDL_PIXELFORMAT_RGBA32, image.pixels.data(), image.w * sizeof(uint32_t)) != 0)
+        {
+            printf("Unable to read pixels! SDL_Error: %s\n", SDL_GetError());
+            return false;
+        }
+        return true;
+    }
+
+} // namespace OWL
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <memory>
+#include <vector>
+#include "backend.h"
+#include "pool.h"
+#include "utils.h"
+
+namespace OWL
+{
+    /**
+     * @brief RenderBackend on top of SDL_Renderer.
+     * @param window the window the renderer draws to
+     */
+    class SdlBackend : public RenderBackend
+    {
+    public:
+        SdlBackend(SDL_Window *window);
+
+        const char *name() const { return "sdl"; }
+
+        TextureHandle createTexture(int w, int h);
+        TextureHandle createTextureFromSurface(SDL_Surface *surface);
+        void destroyTexture(TextureHandle texture) { textures.release(texture); }
+        bool isValid(TextureHandle texture) const { return textures.isValid(texture); }
+        void queryTexture(TextureHandle texture, int *w, int *h);
+        void setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode);
+
+        void setTarget(TextureHandle texture);
+        void setViewport(const SDL_Rect *rect);
+        void setScale(float scaleX, float scaleY);
+        void setDrawColor(SDL_Color color);
+        void setDrawBlendMode(SDL_BlendMode mode);
+
+        void clear();
+        void fillRect(const SDL_Rect *rect);
+        void drawLines(const SDL_Point *points, int count);
+        void copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                  double angle = 0.0, const SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
+        void drawSprites(TextureHandle texture, const Sprite *sprites, int count);
+        void present();
+        bool readPixels(Image &image);
+
+    private:
+        // declared first so the textures are destroyed before the renderer
+        std::shared_ptr<SDL_Renderer> renderer = nullptr;
+        ResourcePool<SDL_Texture> textures;
+        std::vector<SDL_Vertex> vertices; // sprite batch scratch, reused between batches
+        std::vector<int> indices;
+    };
+
+} // namespace OWL
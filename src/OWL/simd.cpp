@@ -0,0 +1,47 @@
+#include "simd.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace OWL
+{
+    static SimdLevel detectSimdLevel()
+    {
+        SimdLevel best = SimdLevel::SCALAR;
+#ifdef OWL_SIMD_SSE2
+        best = SimdLevel::SSE2;
+#endif
+#ifdef OWL_SIMD_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            best = SimdLevel::AVX2;
+#endif
+        const char *forced = getenv("OWL_SIMD");
+        if (forced != nullptr)
+        {
+            if (strcmp(forced, "scalar") == 0)
+                return SimdLevel::SCALAR;
+            if (strcmp(forced, "sse2") == 0 && best >= SimdLevel::SSE2)
+                return SimdLevel::SSE2;
+        }
+        return best;
+    }
+
+    SimdLevel simdLevel()
+    {
+        static SimdLevel level = detectSimdLevel();
+        return level;
+    }
+
+    const char *simdLevelName()
+    {
+        switch (simdLevel())
+        {
+        case SimdLevel::AVX2:
+            return "avx2";
+        case SimdLevel::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+        }
+    }
+
+} // namespace OWL
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace OWL
+{
+    /**
+     * @brief SIMD instruction set used by the engine's vectorized kernels.
+     * @details Detected once at startup. Setting the OWL_SIMD environment variable
+     * to scalar or sse2 forces a lower level, e.g. to compare results between them.
+     */
+    enum class SimdLevel
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    SimdLevel simdLevel();
+    const char *simdLevelName();
+
+} // namespace OWL
+
+#if defined(__SSE2__)
+#define OWL_SIMD_SSE2 1
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define OWL_SIMD_AVX2 1
+#endif
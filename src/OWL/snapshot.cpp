@@ -0,0 +1,385 @@
+#include "snapshot.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+namespace OWL
+{
+    using snapshot::chunkSize;
+
+    //=== Checksum ================================================================
+
+    namespace snapshot
+    {
+        static inline uint64_t mixWord(uint64_t hash, const uint8_t *bytes)
+        {
+            uint64_t word;
+            memcpy(&word, bytes, 8);
+            return (hash ^ word) * 0x100000001b3ull;
+        }
+
+        void Checksum::update(const void *data, size_t n)
+        {
+            const uint8_t *p = static_cast<const uint8_t *>(data);
+            if (pendingBytes > 0)
+            {
+                size_t take = std::min(n, 8 - pendingBytes);
+                memcpy(pending + pendingBytes, p, take);
+                pendingBytes += take;
+                p += take;
+                n -= take;
+                if (pendingBytes < 8)
+                    return;
+                hash = mixWord(hash, pending);
+                pendingBytes = 0;
+            }
+            for (; n >= 8; p += 8, n -= 8)
+                hash = mixWord(hash, p);
+            memcpy(pending, p, n);
+            pendingBytes = n;
+        }
+
+        uint64_t Checksum::finish()
+        {
+            if (pendingBytes > 0)
+            {
+                memset(pending + pendingBytes, 0, 8 - pendingBytes);
+                hash = mixWord(hash, pending);
+                pendingBytes = 0;
+            }
+            return hash;
+        }
+    } // namespace snapshot
+
+    //=== CowBuffer ===============================================================
+
+    // every untouched chunk shares this one, so new space costs no memory until written
+    static const std::shared_ptr<const uint8_t> &zeroChunk()
+    {
+        static const std::shared_ptr<const uint8_t> zero(new uint8_t[chunkSize](), std::default_delete<const uint8_t[]>());
+        return zero;
+    }
+
+    void CowBuffer::resize(size_t size)
+    {
+        size_t count = (size + chunkSize - 1) / chunkSize;
+        size_t oldCount = chunks.size();
+        for (size_t i = count; i < oldCount; i++)
+            if (dirty[i])
+                dirtyChunks--;
+        chunks.resize(count, zeroChunk());
+        owned.resize(count, nullptr);
+        dirty.resize(count, false);
+        for (size_t i = oldCount; i < count; i++)
+            markDirty(i);
+
+        // bytes past the end are kept zero, so whole chunks can be written out as they are
+        if (size < bytes && size % chunkSize != 0)
+        {
+            size_t tail = size % chunkSize;
+            const uint8_t *last = chunks[count - 1].get();
+            if (std::any_of(last + tail, last + chunkSize, [](uint8_t b) { return b != 0; }))
+            {
+                memset(writable(count - 1) + tail, 0, chunkSize - tail);
+                markDirty(count - 1);
+            }
+        }
+        bytes = size;
+    }
+
+    void CowBuffer::read(size_t offset, void *out, size_t n) const
+    {
+        assert(offset + n <= bytes && "CowBuffer read out of range");
+        uint8_t *dst = static_cast<uint8_t *>(out);
+        while (n > 0)
+        {
+            size_t c = offset / chunkSize, o = offset % chunkSize;
+            size_t len = std::min(n, chunkSize - o);
+            memcpy(dst, chunks[c].get() + o, len);
+            dst += len;
+            offset += len;
+            n -= len;
+        }
+    }
+
+    void CowBuffer::write(size_t offset, const void *data, size_t n)
+    {
+        assert(offset + n <= bytes && "CowBuffer write out of range");
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        while (n > 0)
+        {
+            size_t c = offset / chunkSize, o = offset % chunkSize;
+            size_t len = std::min(n, chunkSize - o);
+            if (memcmp(chunks[c].get() + o, src, len) != 0)
+            {
+                memcpy(writable(c) + o, src, len);
+                markDirty(c);
+            }
+            src += len;
+            offset += len;
+            n -= len;
+        }
+    }
+
+    uint8_t *CowBuffer::writable(size_t chunk)
+    {
+        // use_count can only drop behind our back (a finished save), so a stale read just copies once too often
+        if (owned[chunk] != nullptr && chunks[chunk].use_count() == 1)
+        {
+            // use_count is a relaxed load. The fence pairs with the release of the writer dropping its
+            // reference, so the writer's reads of the chunk happen before we write to it in place.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return owned[chunk];
+        }
+        uint8_t *copy = new uint8_t[chunkSize];
+        memcpy(copy, chunks[chunk].get(), chunkSize);
+        chunks[chunk] = std::shared_ptr<const uint8_t>(copy, std::default_delete<const uint8_t[]>());
+        owned[chunk] = copy;
+        return copy;
+    }
+
+    void CowBuffer::markDirty(size_t chunk)
+    {
+        if (!dirty[chunk])
+        {
+            dirty[chunk] = true;
+            dirtyChunks++;
+        }
+    }
+
+    void CowBuffer::clearDirty()
+    {
+        std::fill(dirty.begin(), dirty.end(), false);
+        dirtyChunks = 0;
+    }
+
+    void CowBuffer::share(size_t i, std::shared_ptr<const uint8_t> data, bool markAsDirty)
+    {
+        chunks[i] = std::move(data);
+        owned[i] = nullptr;
+        if (markAsDirty)
+            markDirty(i);
+        else if (dirty[i])
+        {
+            dirty[i] = false;
+            dirtyChunks--;
+        }
+    }
+
+    //=== SnapshotFile ============================================================
+
+    std::shared_ptr<SnapshotFile> SnapshotFile::open(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(snapshot::Header))
+        {
+            printf("Snapshot %s is too short\n", path.c_str());
+            ::close(fd);
+            return nullptr;
+        }
+        size_t size = info.st_size;
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            printf("Unable to map snapshot %s\n", path.c_str());
+            return nullptr;
+        }
+        std::shared_ptr<SnapshotFile> file(new SnapshotFile(static_cast<const uint8_t *>(mapped), size));
+
+        const snapshot::Header &h = file->header();
+        const char *problem = nullptr;
+        if (memcmp(h.magic, snapshot::magic, sizeof(h.magic)) != 0)
+            problem = "not a snapshot";
+        else if (h.version != snapshot::version)
+            problem = "unsupported version";
+        else if (h.fileSize != size || h.chunkSize != chunkSize ||
+                 h.sectionTableOffset + (uint64_t)h.sectionCount * sizeof(snapshot::SectionEntry) > size)
+            problem = "truncated or malformed";
+        else
+        {
+            const snapshot::SectionEntry *entries = reinterpret_cast<const snapshot::SectionEntry *>(file->base + h.sectionTableOffset);
+            for (uint32_t i = 0; i < h.sectionCount && problem == nullptr; i++)
+            {
+                const snapshot::SectionEntry &s = entries[i];
+                if (s.offset + (uint64_t)s.chunkCount * chunkSize > size ||
+                    (file->isDelta() && s.chunkTableOffset + (uint64_t)s.chunkCount * sizeof(uint32_t) > size) ||
+                    (!file->isDelta() && s.chunkCount != (s.size + chunkSize - 1) / chunkSize))
+                    problem = "section out of bounds";
+            }
+        }
+        if (problem == nullptr)
+        {
+            snapshot::Checksum checksum;
+            checksum.update(file->base + sizeof(snapshot::Header), size - sizeof(snapshot::Header));
+            if (checksum.finish() != h.checksum)
+                problem = "checksum mismatch";
+        }
+        if (problem != nullptr)
+        {
+            printf("Snapshot %s rejected: %s\n", path.c_str(), problem);
+            return nullptr;
+        }
+        return file;
+    }
+
+    SnapshotFile::~SnapshotFile()
+    {
+        munmap(const_cast<uint8_t *>(base), size);
+    }
+
+    const snapshot::SectionEntry *SnapshotFile::find(uint32_t id) const
+    {
+        const snapshot::SectionEntry *entries = reinterpret_cast<const snapshot::SectionEntry *>(base + header().sectionTableOffset);
+        for (uint32_t i = 0; i < header().sectionCount; i++)
+            if (entries[i].id == id)
+                return &entries[i];
+        return nullptr;
+    }
+
+    bool SnapshotFile::apply(uint32_t id, CowBuffer &buffer)
+    {
+        const snapshot::SectionEntry *s = find(id);
+        if (s == nullptr)
+            return false;
+        // the chunks alias the mapping and keep this file alive
+        std::shared_ptr<SnapshotFile> self = shared_from_this();
+        buffer.resize(s->size);
+        if (!isDelta())
+        {
+            for (uint32_t i = 0; i < s->chunkCount; i++)
+                buffer.share(i, std::shared_ptr<const uint8_t>(self, base + s->offset + (uint64_t)i * chunkSize), false);
+            return true;
+        }
+        const uint32_t *indices = reinterpret_cast<const uint32_t *>(base + s->chunkTableOffset);
+        for (uint32_t k = 0; k < s->chunkCount; k++)
+            if (indices[k] < buffer.chunkCount())
+                buffer.share(indices[k], std::shared_ptr<const uint8_t>(self, base + s->offset + (uint64_t)k * chunkSize), true);
+        return true;
+    }
+
+    //=== writing =================================================================
+
+    SectionCapture captureSection(uint32_t id, const CowBuffer &buffer, bool dirtyOnly)
+    {
+        SectionCapture capture;
+        capture.id = id;
+        capture.size = buffer.size();
+        capture.chunks.reserve(dirtyOnly ? buffer.dirtyCount() : buffer.chunkCount());
+        for (size_t i = 0; i < buffer.chunkCount(); i++)
+        {
+            if (dirtyOnly && !buffer.isDirty(i))
+                continue;
+            capture.chunks.push_back(buffer.chunk(i));
+            if (dirtyOnly)
+                capture.indices.push_back((uint32_t)i);
+        }
+        return capture;
+    }
+
+    /// Writes to a FILE while checksumming everything after the header.
+    struct SnapshotStream
+    {
+        explicit SnapshotStream(FILE *file) : file{file} {}
+
+        FILE *file;
+        snapshot::Checksum checksum;
+        uint64_t position{sizeof(snapshot::Header)};
+        bool failed{false};
+
+        void put(const void *data, size_t n)
+        {
+            if (n == 0)
+                return;
+            failed |= fwrite(data, 1, n, file) != n;
+            checksum.update(data, n);
+            position += n;
+        }
+
+        void padTo(uint64_t offset)
+        {
+            while (position < offset)
+                put(zeroChunk().get(), std::min<uint64_t>(offset - position, chunkSize));
+        }
+    };
+
+    uint64_t writeSnapshot(const SnapshotCapture &capture)
+    {
+        size_t count = capture.sections.size();
+        std::vector<snapshot::SectionEntry> entries(count);
+
+        // lay the file out: header, section table, chunk index tables, then chunk aligned data
+        uint64_t cursor = sizeof(snapshot::Header) + count * sizeof(snapshot::SectionEntry);
+        for (size_t i = 0; i < count; i++)
+        {
+            const SectionCapture &s = capture.sections[i];
+            entries[i] = {s.id, (uint32_t)s.chunks.size(), s.size, 0, 0};
+            if (capture.delta)
+            {
+                entries[i].chunkTableOffset = cursor;
+                cursor += s.indices.size() * sizeof(uint32_t);
+            }
+        }
+        cursor = (cursor + chunkSize - 1) / chunkSize * chunkSize;
+        for (size_t i = 0; i < count; i++)
+        {
+            entries[i].offset = cursor;
+            cursor += (uint64_t)entries[i].chunkCount * chunkSize;
+        }
+
+        snapshot::Header header{};
+        memcpy(header.magic, snapshot::magic, sizeof(header.magic));
+        header.version = snapshot::version;
+        header.flags = capture.delta ? (uint32_t)snapshot::DELTA : 0;
+        header.fileSize = cursor;
+        header.baseChecksum = capture.baseChecksum;
+        header.sequence = capture.sequence;
+        header.sectionCount = (uint32_t)count;
+        header.chunkSize = chunkSize;
+        header.sectionTableOffset = sizeof(snapshot::Header);
+
+        std::string tmpPath = capture.path + ".tmp";
+        FILE *file = fopen(tmpPath.c_str(), "wb");
+        if (file == nullptr)
+        {
+            printf("Unable to write snapshot %s\n", tmpPath.c_str());
+            return 0;
+        }
+        SnapshotStream out{file};
+        fwrite(&header, sizeof(header), 1, file);
+        out.put(entries.data(), count * sizeof(snapshot::SectionEntry));
+        if (capture.delta)
+            for (const auto &s : capture.sections)
+                out.put(s.indices.data(), s.indices.size() * sizeof(uint32_t));
+        for (size_t i = 0; i < count; i++)
+        {
+            out.padTo(entries[i].offset);
+            for (const auto &chunk : capture.sections[i].chunks)
+                out.put(chunk.get(), chunkSize);
+        }
+        out.padTo(cursor);
+
+        header.checksum = out.checksum.finish();
+        fseek(file, 0, SEEK_SET);
+        out.failed |= fwrite(&header, sizeof(header), 1, file) != 1;
+        out.failed |= fflush(file) != 0 || fsync(fileno(file)) != 0;
+        out.failed |= fclose(file) != 0;
+        if (out.failed || rename(tmpPath.c_str(), capture.path.c_str()) != 0)
+        {
+            printf("Unable to write snapshot %s\n", capture.path.c_str());
+            remove(tmpPath.c_str());
+            return 0;
+        }
+        return header.checksum;
+    }
+
+} // namespace OWL
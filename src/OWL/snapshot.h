@@ -0,0 +1,190 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OWL
+{
+    /**
+     * @brief Binary save-state format, version 1.
+     * @details A snapshot file is laid out so it can be used straight from an mmap:
+     *
+     *     [Header][SectionEntry x sectionCount][delta chunk index tables][pad]
+     *     [section data, chunkSize aligned] ...
+     *
+     * Every reference is a byte offset from the start of the file, and every section
+     * starts on a chunkSize boundary and is zero padded to whole chunks.
+     * The checksum covers everything after the header.
+     *
+     * A full snapshot stores each section whole. A delta snapshot stores only some
+     * chunks of each section, listed in its chunk index table. It applies on top of
+     * the full snapshot whose checksum is in baseChecksum.
+     * All numbers are in native byte order.
+     */
+    namespace snapshot
+    {
+        const char magic[8] = {'O', 'W', 'L', 'S', 'N', 'A', 'P', 0};
+        const uint32_t version = 1;
+        const uint32_t chunkSize = 4096;
+
+        enum Flags : uint32_t
+        {
+            DELTA = 1
+        };
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t flags;
+            uint64_t fileSize;
+            uint64_t checksum;     // of bytes [sizeof(Header), fileSize)
+            uint64_t baseChecksum; // DELTA: the full snapshot this applies to
+            uint64_t sequence;     // counts up with every save
+            uint32_t sectionCount;
+            uint32_t chunkSize;
+            uint64_t sectionTableOffset;
+        };
+        static_assert(sizeof(Header) == 64, "snapshot::Header layout");
+
+        struct SectionEntry
+        {
+            uint32_t id;
+            uint32_t chunkCount;       // chunks stored in the file
+            uint64_t size;             // full size of the section in bytes
+            uint64_t offset;           // first stored chunk
+            uint64_t chunkTableOffset; // DELTA: chunkCount uint32 chunk indices, in storage order
+        };
+        static_assert(sizeof(SectionEntry) == 32, "snapshot::SectionEntry layout");
+
+        /// Section ids are four characters, e.g. sectionId("MAP0").
+        constexpr uint32_t sectionId(const char (&name)[5])
+        {
+            return (uint32_t)(uint8_t)name[0] | ((uint32_t)(uint8_t)name[1] << 8) |
+                   ((uint32_t)(uint8_t)name[2] << 16) | ((uint32_t)(uint8_t)name[3] << 24);
+        }
+
+        /// Streaming 64-bit FNV-1a over 8-byte words, the last word zero padded.
+        class Checksum
+        {
+        public:
+            void update(const void *data, size_t n);
+            uint64_t finish();
+
+        private:
+            uint64_t hash{0xcbf29ce484222325ull};
+            uint8_t pending[8];
+            size_t pendingBytes{0};
+        };
+    } // namespace snapshot
+
+    /**
+     * @brief Byte buffer split into chunkSize chunks that are shared copy-on-write.
+     * @details Taking a capture only copies the chunk pointers, so it costs nothing
+     * per byte. A later write to a chunk that a capture (or a mapped snapshot) still
+     * references copies that chunk first, so the capture keeps the old bytes.
+     * Writes only mark chunks dirty when their bytes actually change, so state can be
+     * rewritten whole and still produce small deltas.
+     */
+    class CowBuffer
+    {
+    public:
+        explicit CowBuffer(size_t size = 0) { resize(size); }
+
+        /// Grow or shrink. New bytes are zero and their chunks dirty.
+        void resize(size_t size);
+        size_t size() const { return bytes; }
+        size_t chunkCount() const { return chunks.size(); }
+
+        void read(size_t offset, void *out, size_t n) const;
+        void write(size_t offset, const void *data, size_t n);
+        template <typename T>
+        T get(size_t offset) const
+        {
+            T value;
+            read(offset, &value, sizeof(T));
+            return value;
+        }
+        template <typename T>
+        void set(size_t offset, const T &value)
+        {
+            write(offset, &value, sizeof(T));
+        }
+
+        bool isDirty(size_t chunk) const { return dirty[chunk]; }
+        size_t dirtyCount() const { return dirtyChunks; }
+        void clearDirty();
+
+        /// Shared reference to a chunk's bytes, for captures.
+        std::shared_ptr<const uint8_t> chunk(size_t i) const { return chunks[i]; }
+        /// Use read-only bytes owned by someone else as chunk i. They are copied before the first write.
+        void share(size_t i, std::shared_ptr<const uint8_t> data, bool markDirty);
+
+    private:
+        std::vector<std::shared_ptr<const uint8_t>> chunks;
+        std::vector<uint8_t *> owned; // writable pointer when the chunk was allocated here, else nullptr
+        std::vector<bool> dirty;
+        size_t bytes{0};
+        size_t dirtyChunks{0};
+
+        uint8_t *writable(size_t chunk);
+        void markDirty(size_t chunk);
+    };
+
+    /**
+     * @brief A snapshot file mapped read-only into memory.
+     * @details open() checks the magic, version, size and checksum before handing the file out.
+     * Sections are loaded into CowBuffers without copying: their chunks point into the mapping,
+     * which stays mapped as long as any buffer still uses it.
+     */
+    class SnapshotFile : public std::enable_shared_from_this<SnapshotFile>
+    {
+    public:
+        /// Map and verify path. Returns nullptr, after printing why, if it isn't a valid snapshot.
+        static std::shared_ptr<SnapshotFile> open(const std::string &path);
+        ~SnapshotFile();
+
+        const snapshot::Header &header() const { return *reinterpret_cast<const snapshot::Header *>(base); }
+        const snapshot::SectionEntry *find(uint32_t id) const;
+        bool isDelta() const { return header().flags & snapshot::DELTA; }
+
+        /// Load section id into buffer. Full snapshots replace it, deltas patch their chunks in and mark them dirty.
+        bool apply(uint32_t id, CowBuffer &buffer);
+
+    private:
+        SnapshotFile(const uint8_t *base, size_t size) : base{base}, size{size} {}
+        const uint8_t *base;
+        size_t size;
+    };
+
+    /// One section of a capture: the chunk pointers at the moment of capture.
+    struct SectionCapture
+    {
+        uint32_t id;
+        uint64_t size;
+        std::vector<std::shared_ptr<const uint8_t>> chunks; // delta: only the chunks listed in indices
+        std::vector<uint32_t> indices;                      // delta: which chunks these are
+    };
+
+    struct SnapshotCapture
+    {
+        std::string path;
+        bool delta{false};
+        uint64_t baseChecksum{0};
+        uint64_t sequence{0};
+        std::vector<SectionCapture> sections;
+    };
+
+    /// Take the chunks of buffer. With dirtyOnly, only the dirty ones, for a delta.
+    SectionCapture captureSection(uint32_t id, const CowBuffer &buffer, bool dirtyOnly);
+
+    /**
+     * @brief Write a capture to disk: to path.tmp first, then renamed over path.
+     * @return the file's checksum, or 0 if it couldn't be written
+     */
+    uint64_t writeSnapshot(const SnapshotCapture &capture);
+
+} // namespace OWL
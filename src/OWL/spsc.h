@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+namespace OWL
+{
+    /**
+     * @brief Fixed-size lock-free queue for exactly one producer thread and one consumer thread.
+     * @details push() is only called from the producer and pop() only from the consumer.
+     * Neither ever blocks or allocates: push() fails when the queue is full and pop()
+     * fails when it is empty. The two indices sit on separate cache lines so the
+     * threads don't fight over one line.
+     *
+     * @tparam T trivially copyable item type
+     * @tparam Capacity number of slots, a power of two
+     */
+    template <typename T, size_t Capacity>
+    class SpscQueue
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    public:
+        /// Producer side. Returns false, dropping item, if the queue is full.
+        bool push(const T &item)
+        {
+            size_t write = writeIndex.load(std::memory_order_relaxed);
+            if (write - readIndex.load(std::memory_order_acquire) == Capacity)
+                return false;
+            items[write & (Capacity - 1)] = item;
+            writeIndex.store(write + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Consumer side. Returns false if the queue is empty.
+        bool pop(T &item)
+        {
+            size_t read = readIndex.load(std::memory_order_relaxed);
+            if (read == writeIndex.load(std::memory_order_acquire))
+                return false;
+            item = items[read & (Capacity - 1)];
+            readIndex.store(read + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Approximate when called while the other thread is active.
+        size_t size() const
+        {
+            return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+        }
+
+    private:
+        alignas(64) std::atomic<size_t> writeIndex{0}; // next slot to write, only the producer stores it
+        alignas(64) std::atomic<size_t> readIndex{0};  // next slot to read, only the consumer stores it
+        alignas(64) T items[Capacity];
+    };
+
+} // namespace OWL
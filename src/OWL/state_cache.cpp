@@ -0,0 +1,177 @@
+#include "state_cache.h"
+
+namespace OWL
+{
+    uint32_t RenderStateStats::totalIssued() const
+    {
+        uint32_t total = 0;
+        for (uint32_t n : issued)
+            total += n;
+        return total;
+    }
+
+    uint32_t RenderStateStats::totalElided() const
+    {
+        uint32_t total = 0;
+        for (uint32_t n : elided)
+            total += n;
+        return total;
+    }
+
+    StateCacheBackend::StateCacheBackend(std::unique_ptr<RenderBackend> backend, bool enabled)
+        : backend{std::move(backend)}, enabled{enabled}
+    {
+    }
+
+    bool StateCacheBackend::count(RenderState state, bool changes)
+    {
+        changes = changes || !enabled;
+        if (changes)
+            current.issued[(int)state]++;
+        else
+            current.elided[(int)state]++;
+        return changes;
+    }
+
+    void StateCacheBackend::switchTarget(TextureHandle texture)
+    {
+        if (targetKnown && texture == target)
+            return;
+        if (texture)
+        {
+            // a texture target starts with the whole texture as viewport, unscaled
+            if (targetKnown && !target)
+                screenView = view;
+            else if (!targetKnown)
+                screenView = View();
+            view = View();
+            view.viewportKnown = view.fullViewport = true;
+            view.scaleKnown = true;
+        }
+        else
+            view = targetKnown ? screenView : View();
+        target = texture;
+        targetKnown = true;
+    }
+
+    void StateCacheBackend::setTarget(TextureHandle texture)
+    {
+        // backends render to the screen when given a stale handle
+        if (!backend->isValid(texture))
+            texture = TextureHandle();
+        if (count(RenderState::TARGET, !targetKnown || texture != target))
+        {
+            backend->setTarget(texture);
+            switchTarget(texture);
+        }
+    }
+
+    void StateCacheBackend::setViewport(const SDL_Rect *rect)
+    {
+        bool same = view.viewportKnown;
+        if (same && rect == NULL)
+            same = view.fullViewport;
+        else if (same)
+            // a rect is multiplied by the scale at the time it is set
+            same = !view.fullViewport && view.scaleKnown && rect->x == view.viewport.x && rect->y == view.viewport.y &&
+                   rect->w == view.viewport.w && rect->h == view.viewport.h &&
+                   view.scaleX == view.viewportScaleX && view.scaleY == view.viewportScaleY;
+        if (count(RenderState::VIEWPORT, !same))
+        {
+            backend->setViewport(rect);
+            view.viewportKnown = rect == NULL || view.scaleKnown;
+            view.fullViewport = rect == NULL;
+            if (rect != NULL)
+                view.viewport = *rect;
+            view.viewportScaleX = view.scaleX;
+            view.viewportScaleY = view.scaleY;
+        }
+    }
+
+    void StateCacheBackend::setScale(float scaleX, float scaleY)
+    {
+        bool same = view.scaleKnown && scaleX == view.scaleX && scaleY == view.scaleY;
+        if (count(RenderState::SCALE, !same))
+        {
+            backend->setScale(scaleX, scaleY);
+            view.scaleKnown = true;
+            view.scaleX = scaleX;
+            view.scaleY = scaleY;
+        }
+    }
+
+    void StateCacheBackend::setDrawColor(SDL_Color color)
+    {
+        bool same = colorKnown && color.r == this->color.r && color.g == this->color.g &&
+                    color.b == this->color.b && color.a == this->color.a;
+        if (count(RenderState::DRAW_COLOR, !same))
+        {
+            backend->setDrawColor(color);
+            colorKnown = true;
+            this->color = color;
+        }
+    }
+
+    void StateCacheBackend::setDrawBlendMode(SDL_BlendMode mode)
+    {
+        if (count(RenderState::BLEND_MODE, !blendKnown || mode != blend))
+        {
+            backend->setDrawBlendMode(mode);
+            blendKnown = true;
+            blend = mode;
+        }
+    }
+
+    TextureHandle StateCacheBackend::tracked(TextureHandle texture)
+    {
+        if (!texture)
+            return texture;
+        int w, h;
+        backend->queryTexture(texture, &w, &h);
+        if (texture.index() >= textureMemory.size())
+            textureMemory.resize(texture.index() + 1);
+        textureMemory[texture.index()] = {(int64_t)w * h * 4, MemoryScope::current()};
+        trackTextureBytes(MemoryScope::current(), (int64_t)w * h * 4);
+        return texture;
+    }
+
+    TextureHandle StateCacheBackend::createTexture(int w, int h)
+    {
+        return tracked(backend->createTexture(w, h));
+    }
+
+    TextureHandle StateCacheBackend::createTextureFromSurface(SDL_Surface *surface)
+    {
+        return tracked(backend->createTextureFromSurface(surface));
+    }
+
+    void StateCacheBackend::destroyTexture(TextureHandle texture)
+    {
+        if (backend->isValid(texture))
+        {
+            TextureMemory &memory = textureMemory[texture.index()];
+            trackTextureBytes(memory.tag, -memory.bytes);
+            memory.bytes = 0;
+        }
+        backend->destroyTexture(texture);
+        // destroying the target puts the backend back on the screen
+        if (targetKnown && target && texture == target)
+            switchTarget(TextureHandle());
+    }
+
+    void StateCacheBackend::present()
+    {
+        backend->present();
+        previous = current;
+        current = RenderStateStats();
+    }
+
+    bool StateCacheBackend::readPixels(Image &image)
+    {
+        bool read = backend->readPixels(image);
+        // the SDL backend widens the viewport to read the whole screen
+        view.viewportKnown = false;
+        return read;
+    }
+
+} // namespace OWL
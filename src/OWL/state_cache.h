@@ -0,0 +1,127 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "alloc.h"
+#include "backend.h"
+
+namespace OWL
+{
+    enum class RenderState
+    {
+        TARGET,
+        VIEWPORT,
+        SCALE,
+        DRAW_COLOR,
+        BLEND_MODE,
+        COUNT
+    };
+
+    /// State changes of one frame: issued reached the backend, elided were dropped as no-ops.
+    struct RenderStateStats
+    {
+        uint32_t issued[(int)RenderState::COUNT]{};
+        uint32_t elided[(int)RenderState::COUNT]{};
+
+        uint32_t totalIssued() const;
+        uint32_t totalElided() const;
+    };
+
+    /**
+     * @brief RenderBackend that drops state changes which wouldn't change anything.
+     * @details Keeps a shadow copy of the target, viewport, scale, draw color and draw
+     * blend mode, and only forwards a state call to the wrapped backend when it differs.
+     * The shadow follows SDL_Renderer's rules: switching to a texture target resets the
+     * viewport and scale, switching back to the screen restores the screen's. State
+     * nobody has set yet, or that the backend changed on its own, is unknown and the
+     * next call for it is always issued.
+     *
+     * Counters are per frame and roll over at present().
+     *
+     * As every texture Draw uses is created through here, on the thread that draws, this
+     * is also where their memory is estimated: 4 bytes per pixel, accounted to the
+     * MemoryTag in scope when the texture was created (see alloc.h).
+     * @param backend the backend to forward to
+     * @param enabled false forwards every call, still counting them, to rule the cache out
+     */
+    class StateCacheBackend : public RenderBackend
+    {
+    public:
+        StateCacheBackend(std::unique_ptr<RenderBackend> backend, bool enabled = true);
+
+        /// Counters of the last presented frame.
+        const RenderStateStats &lastFrame() const { return previous; }
+        bool isEnabled() const { return enabled; }
+
+        const char *name() const { return backend->name(); }
+
+        //=== textures ===
+        TextureHandle createTexture(int w, int h);
+        TextureHandle createTextureFromSurface(SDL_Surface *surface);
+        void destroyTexture(TextureHandle texture);
+        bool isValid(TextureHandle texture) const { return backend->isValid(texture); }
+        void queryTexture(TextureHandle texture, int *w, int *h) { backend->queryTexture(texture, w, h); }
+        void setTextureBlendMode(TextureHandle texture, SDL_BlendMode mode) { backend->setTextureBlendMode(texture, mode); }
+
+        //=== state ===
+        void setTarget(TextureHandle texture);
+        void setViewport(const SDL_Rect *rect);
+        void setScale(float scaleX, float scaleY);
+        void setDrawColor(SDL_Color color);
+        void setDrawBlendMode(SDL_BlendMode mode);
+
+        //=== drawing ===
+        void clear() { backend->clear(); }
+        void fillRect(const SDL_Rect *rect) { backend->fillRect(rect); }
+        void drawLines(const SDL_Point *points, int count) { backend->drawLines(points, count); }
+        void copy(TextureHandle texture, const SDL_Rect *src, const SDL_Rect *dst,
+                  double angle = 0.0, const SDL_Point *center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE)
+        {
+            backend->copy(texture, src, dst, angle, center, flip);
+        }
+        void drawSprites(TextureHandle texture, const Sprite *sprites, int count) { backend->drawSprites(texture, sprites, count); }
+        void present();
+        bool readPixels(Image &image);
+
+    private:
+        /// Viewport and scale, the part of the state each target keeps for itself.
+        struct View
+        {
+            bool viewportKnown{false};
+            bool fullViewport{false}; // set with NULL
+            SDL_Rect viewport{};
+            float viewportScaleX{1.0f}, viewportScaleY{1.0f}; // a rect viewport is scaled when set
+            bool scaleKnown{false};
+            float scaleX{1.0f}, scaleY{1.0f};
+        };
+
+        std::unique_ptr<RenderBackend> backend;
+        bool enabled;
+
+        bool targetKnown{false};
+        TextureHandle target;
+        View view;
+        View screenView; // while a texture is the target
+        bool colorKnown{false};
+        SDL_Color color{};
+        bool blendKnown{false};
+        SDL_BlendMode blend{SDL_BLENDMODE_NONE};
+
+        RenderStateStats current, previous;
+
+        struct TextureMemory
+        {
+            int64_t bytes;
+            MemoryTag tag;
+        };
+        std::vector<TextureMemory> textureMemory; // by handle index
+
+        /// Count the change, return whether it has to be issued.
+        bool count(RenderState state, bool changes);
+        void switchTarget(TextureHandle texture);
+        TextureHandle tracked(TextureHandle texture);
+    };
+
+} // namespace OWL
@@ -0,0 +1,257 @@
+#include "telemetry.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "clock.h"
+
+namespace OWL
+{
+    static const size_t maxCommand = 1024;
+
+    Telemetry::Telemetry(std::shared_ptr<MessageBus> msgBus, std::string path)
+        : BusNode(msgBus, "Telemetry"), path{path}, lastSample{ticks()}, lastMessageCount{msgBus->messageCount()}
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            printf("Telemetry socket path too long: %s\n", path.c_str());
+            return;
+        }
+        strcpy(address.sun_path, path.c_str());
+
+        // a socket file left behind by a crashed run would make bind fail. Anything else is left alone,
+        // a mistyped path must not delete the file it names.
+        struct stat existing;
+        if (lstat(path.c_str(), &existing) == 0)
+        {
+            if (!S_ISSOCK(existing.st_mode))
+            {
+                printf("Telemetry socket %s could not be opened: the path exists and is not a socket\n", path.c_str());
+                return;
+            }
+            unlink(path.c_str());
+        }
+
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        // every command a client sends goes to the bus, so only our user may connect. Nobody can
+        // connect between bind and listen, so restricting the mode in between leaves no window.
+        if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) < 0 || chmod(path.c_str(), 0600) < 0 ||
+            listen(listener, 4) < 0 ||
+            fcntl(listener, F_SETFL, O_NONBLOCK) < 0 || pipe(wakePipe) < 0)
+        {
+            printf("Telemetry socket %s could not be opened: %s\n", path.c_str(), strerror(errno));
+            if (listener >= 0)
+                close(listener);
+            listener = -1;
+            return;
+        }
+        worker = std::thread(&Telemetry::run, this);
+        send({"Telemetry: listening on " + path});
+    }
+
+    Telemetry::~Telemetry()
+    {
+        if (listener < 0)
+            return;
+        write(wakePipe[1], "q", 1);
+        worker.join();
+        close(listener);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        unlink(path.c_str());
+    }
+
+    void Telemetry::addCounter(std::string name, std::function<double()> read)
+    {
+        counters.push_back({std::move(name), std::move(read)});
+    }
+
+    void Telemetry::post(std::string line)
+    {
+        MemoryScope scope(MemoryTag::TELEMETRY);
+        std::lock_guard<std::mutex> lock(mutex);
+        outbox.push_back(std::move(line));
+    }
+
+    void Telemetry::frame(double frameMs, double workMs)
+    {
+        // dropped when the server thread is behind, the next second's lines catch up
+        if (clientCount > 0)
+            frames.push({frameNumber, (float)frameMs, (float)workMs});
+        frameNumber++;
+    }
+
+    void Telemetry::update()
+    {
+        std::vector<std::string> commands;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.swap(inbox);
+        }
+        for (auto &command : commands)
+            send({command});
+
+        uint32_t now = ticks();
+        if (now - lastSample < 1000)
+            return;
+        uint64_t messages = messageBus->messageCount();
+        if (clientCount > 0)
+        {
+            char line[160];
+            snprintf(line, sizeof(line), "rate messages %.1f", (messages - lastMessageCount) * 1000.0 / (now - lastSample));
+            post(line);
+            for (auto &counter : counters)
+            {
+                snprintf(line, sizeof(line), "counter %s %.17g", counter.name.c_str(), counter.read());
+                post(line);
+            }
+        }
+        lastSample = now;
+        lastMessageCount = messages;
+    }
+
+    void Telemetry::onNotify(const Message &msg)
+    {
+        MemoryScope scope(MemoryTag::TELEMETRY);
+        if (clientCount == 0)
+            return;
+        std::string line = "msg";
+        for (const auto &param : msg.getParameters())
+            line += " " + param;
+        // one message, one line
+        for (auto &c : line)
+            if (c == '\n' || c == '\r')
+                c = ' ';
+        post(std::move(line));
+    }
+
+    //=== server thread ===========================================================
+
+    bool Telemetry::readCommands(Client &client, std::vector<std::string> &commands)
+    {
+        size_t start = 0, end;
+        while ((end = client.in.find('\n', start)) != std::string::npos)
+        {
+            std::string line = client.in.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                commands.push_back(line);
+            start = end + 1;
+        }
+        client.in.erase(0, start);
+        return client.in.size() <= maxCommand;
+    }
+
+    bool Telemetry::flush(Client &client)
+    {
+        while (!client.out.empty())
+        {
+            ssize_t sent = ::send(client.fd, client.out.data(), client.out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0)
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            client.out.erase(0, sent);
+        }
+        return true;
+    }
+
+    void Telemetry::run()
+    {
+        MemoryScope scope(MemoryTag::TELEMETRY);
+        std::vector<Client> clients, kept;
+        std::vector<pollfd> fds;
+        std::vector<std::string> lines, commands;
+        char buffer[4096];
+        while (true)
+        {
+            fds.clear();
+            fds.push_back({wakePipe[0], POLLIN, 0});
+            fds.push_back({listener, POLLIN, 0});
+            for (auto &client : clients)
+                fds.push_back({client.fd, (short)((client.readClosed ? 0 : POLLIN) | (client.out.empty() ? 0 : POLLOUT)), 0});
+            // frames and bus lines are picked up at least this often
+            poll(fds.data(), fds.size(), 20);
+            if (fds[0].revents & POLLIN)
+                break;
+
+            if (fds[1].revents & POLLIN)
+            {
+                int fd;
+                while ((fd = accept(listener, NULL, NULL)) >= 0)
+                {
+                    fcntl(fd, F_SETFL, O_NONBLOCK);
+                    clients.push_back({fd, "", "", false});
+                }
+            }
+
+            // gather everything to send since the last round
+            lines.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lines.swap(outbox);
+            }
+            std::string stream;
+            FrameSample sample;
+            char line[96];
+            while (frames.pop(sample))
+            {
+                snprintf(line, sizeof(line), "frame %llu %.3f %.3f\n", (unsigned long long)sample.number, sample.frameMs, sample.workMs);
+                stream += line;
+            }
+            for (auto &text : lines)
+                stream += text + "\n";
+
+            commands.clear();
+            size_t polled = fds.size() - 2; // clients accepted this round weren't polled yet
+            kept.clear();
+            for (size_t i = 0; i < clients.size(); i++)
+            {
+                Client &client = clients[i];
+                bool alive = true;
+                short events = i < polled ? fds[i + 2].revents : 0;
+                if (!client.readClosed && (events & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    ssize_t n;
+                    while ((n = recv(client.fd, buffer, sizeof(buffer), 0)) > 0)
+                        client.in.append(buffer, n);
+                    bool failed = n < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+                    if (n == 0)
+                    {
+                        // done sending, maybe only half-closed and waiting for the replies. The
+                        // commands sent before, a last one without newline too, still count.
+                        client.readClosed = true;
+                        if (!client.in.empty())
+                            client.in += '\n';
+                    }
+                    alive = readCommands(client, commands) && !failed;
+                }
+                else if (client.readClosed && (events & (POLLHUP | POLLERR)))
+                    alive = false;
+                client.out += stream;
+                if (alive && flush(client) && client.out.size() <= maxBacklog)
+                    kept.push_back(std::move(client));
+                else
+                    close(client.fd);
+            }
+            clients.swap(kept);
+            clientCount = (int)clients.size();
+
+            if (!commands.empty())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inbox.insert(inbox.end(), commands.begin(), commands.end());
+            }
+        }
+        for (auto &client : clients)
+            close(client.fd);
+    }
+
+} // namespace OWL
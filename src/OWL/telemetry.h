@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "msg.h"
+#include "spsc.h"
+
+namespace OWL
+{
+    /**
+     * @brief Live telemetry and a remote console on a local UNIX domain socket.
+     * @details A server thread accepts any number of clients and streams newline-separated lines to them:
+     *
+     *     frame <number> <frame ms> <work ms>   every frame: time since the last frame, time spent in it
+     *     rate messages <per second>            every second: messages delivered by the MessageBus
+     *     counter <name> <value>                every second: each registered counter
+     *     msg <text>                            every message on the bus, parameters joined by spaces
+     *
+     * Every line a client sends is injected into the bus as a message, so ":audio" does what
+     * typing it into the console does, and "quitgame" stops the game.
+     *
+     * The game thread never waits on the socket. Frame samples go through a lock-free queue,
+     * the rest through short locked swaps. A client that can't keep up is disconnected once
+     * its backlog grows past maxBacklog, so it can't make the server buffer without bound.
+     * Counters are read on the game thread, since they read game state.
+     *
+     * The socket file is only accessible to the user running the game (mode 0600), since whoever
+     * can connect can drive it.
+     *
+     * @param path where to create the socket. An existing socket file there is replaced; if anything
+     * else is there, the server doesn't start.
+     */
+    class Telemetry : public BusNode
+    {
+    public:
+        Telemetry(std::shared_ptr<MessageBus> msgBus, std::string path);
+        ~Telemetry();
+
+        bool isOpen() const { return listener >= 0; }
+        const std::string &getPath() const { return path; }
+
+        /// Stream a value once per second as "counter <name> <value>".
+        void addCounter(std::string name, std::function<double()> read);
+        /// Record one frame: the time since the previous one and the time its work took, in milliseconds.
+        void frame(double frameMs, double workMs);
+        /// Inject received commands into the bus and sample the counters when due. Call once per frame.
+        void update();
+
+        static const size_t maxBacklog = 1 << 18; // bytes queued for one client
+
+    private:
+        struct FrameSample
+        {
+            uint64_t number;
+            float frameMs;
+            float workMs;
+        };
+        struct Counter
+        {
+            std::string name;
+            std::function<double()> read;
+        };
+        struct Client
+        {
+            int fd;
+            std::string in, out; // partial command line, lines not sent yet
+            bool readClosed;     // the client shut down its sending side, it still gets lines
+        };
+
+        std::string path;
+        int listener{-1};
+        int wakePipe[2]{-1, -1}; // written to stop the server thread
+        std::thread worker;
+        std::atomic<int> clientCount{0};
+
+        // game thread
+        std::vector<Counter> counters;
+        uint64_t frameNumber{0};
+        uint32_t lastSample;
+        uint64_t lastMessageCount{0};
+
+        SpscQueue<FrameSample, 1024> frames;
+        // guarded by mutex
+        std::mutex mutex;
+        std::vector<std::string> outbox; // lines for every client
+        std::vector<std::string> inbox;  // commands for the bus
+
+        void post(std::string line);
+        void run();
+        /// Move complete lines from a client's input to the inbox. Returns false on a line too long to be a command.
+        bool readCommands(Client &client, std::vector<std::string> &commands);
+        /// Send what the socket takes without blocking. Returns false if the client is gone.
+        bool flush(Client &client);
+
+        void onNotify(const Message &msg);
+    };
+
+} // namespace OWL
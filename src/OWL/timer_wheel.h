@@ -0,0 +1,293 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "pool.h"
+
+namespace OWL
+{
+    struct TimerTag;
+    typedef Handle<TimerTag> TimerHandle;
+
+    /**
+     * @brief Hierarchical timing wheels: timers with O(1) schedule and cancel.
+     * @details Time is in ticks of 1 ms, counted in 64 bits so it never wraps. There are
+     * levels wheels of 256 slots. Level 0 has one slot per tick of the coming 256, level 1
+     * one per 256 ticks, and so on. A timer goes into the lowest level whose slot size
+     * covers the distance from now to its due time: the highest 8-bit digit in which the two
+     * differ. Whenever a level's slot index comes round to 0, the next level's current slot
+     * is cascaded down and its timers are spread over the finer slots. So a timer is
+     * touched at most once per level, and the wheel never scans timers that aren't due.
+     *
+     * Slots are intrusive doubly linked lists through one pool of nodes, so cancelling by
+     * handle is O(1). Per level a 256-bit occupancy mask lets advance() jump straight to
+     * the next non-empty slot instead of visiting every tick.
+     *
+     * Timers due at the same tick fire in the order they were scheduled (a periodic timer
+     * counts as scheduled again each time it fires). Together with a deterministic clock,
+     * the same schedule/cancel/advance calls always fire the same timers in the same order.
+     *
+     * @tparam T payload handed back when the timer fires
+     */
+    template <typename T>
+    class TimerWheel
+    {
+    public:
+        static constexpr int levels = 5; // 40 bits of ticks, enough for any uint32_t delay
+        static constexpr int slotBits = 8;
+        static constexpr int slots = 1 << slotBits;
+
+        explicit TimerWheel(uint64_t start = 0) : current{start}
+        {
+            std::fill(std::begin(heads), std::end(heads), none);
+            std::fill(&occupied[0][0], &occupied[0][0] + levels * slots / 64, 0);
+        }
+
+        uint64_t now() const { return current; }
+        size_t size() const { return pending; }
+
+        /**
+         * @brief Fire payload at tick due, then every period ticks if period isn't 0.
+         * @details A due time that isn't after now() fires on the next advance().
+         * If every index a handle can hold is in use, nothing is scheduled and a null
+         * handle returned, in release builds too.
+         */
+        TimerHandle schedule(uint64_t due, T payload, uint32_t period = 0)
+        {
+            uint32_t index;
+            if (!freeNodes.empty())
+            {
+                index = freeNodes.back();
+                freeNodes.pop_back();
+            }
+            else
+            {
+                index = (uint32_t)nodes.size();
+                if (index > TimerHandle::indexMask)
+                    return TimerHandle();
+                nodes.emplace_back();
+                nodes.back().generation = 1;
+            }
+            Node &node = nodes[index];
+            node.due = due;
+            node.period = period;
+            node.sequence = nextSequence++;
+            node.payload = std::move(payload);
+            insert(index);
+            pending++;
+            return TimerHandle::make(index, node.generation);
+        }
+
+        /// Returns false if the timer already fired (and wasn't periodic) or was cancelled.
+        bool cancel(TimerHandle timer)
+        {
+            Node *node = find(timer);
+            if (node == nullptr)
+                return false;
+            if (node->list != firing)
+                unlink(timer.index());
+            release(timer.index());
+            return true;
+        }
+
+        bool isPending(TimerHandle timer) const { return const_cast<TimerWheel *>(this)->find(timer) != nullptr; }
+
+        /**
+         * @brief Move time forward to now and fire every timer due until then.
+         * @details Calls fire(payload, due) in order of due time, timers due at the same tick
+         * in scheduling order. fire may schedule and cancel timers, including the ones in
+         * the batch being fired.
+         */
+        template <typename Fire>
+        void advance(uint64_t now, Fire fire)
+        {
+            fireList(ready, fire);
+            while (current < now)
+            {
+                // the next occupied level 0 slot in this round of the wheel, if it's due
+                int slot = nextOccupied(0, (int)(current & (slots - 1)) + 1);
+                uint64_t roundStart = current & ~(uint64_t)(slots - 1);
+                if (slot < slots && roundStart + slot <= now)
+                {
+                    current = roundStart + slot;
+                    fireList(slot, fire);
+                    continue;
+                }
+                uint64_t nextRound = roundStart + slots;
+                if (nextRound > now)
+                {
+                    current = now;
+                    break;
+                }
+                current = nextRound;
+                cascade();
+                fireList(0, fire);
+            }
+        }
+
+    private:
+        static constexpr uint32_t none = UINT32_MAX;
+        static constexpr uint32_t ready = levels * slots; // list of timers due already
+        static constexpr uint32_t firing = ready + 1;     // taken out of the wheel, about to fire
+        static constexpr uint32_t unused = ready + 2;
+
+        struct Node
+        {
+            uint64_t due;
+            uint64_t sequence;
+            uint32_t period;
+            uint32_t generation;
+            uint32_t list{unused};
+            uint32_t prev, next;
+            T payload;
+        };
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> freeNodes;
+        uint32_t heads[levels * slots + 1];
+        uint64_t occupied[levels][slots / 64];
+        uint64_t current;
+        uint64_t nextSequence{0};
+        size_t pending{0};
+        std::vector<std::pair<uint64_t, uint32_t>> batch; // (sequence, node) of the slot being fired
+
+        Node *find(TimerHandle timer)
+        {
+            if (timer.isNull() || timer.index() >= nodes.size())
+                return nullptr;
+            Node &node = nodes[timer.index()];
+            return node.list != unused && node.generation == timer.generation() ? &node : nullptr;
+        }
+
+        /// Link a node into its slot. Cascaded timers can be due now, they go into the level 0 slot about to fire.
+        void insert(uint32_t index, bool cascading = false)
+        {
+            Node &node = nodes[index];
+            uint32_t list = ready;
+            if (node.due > current || (cascading && node.due == current))
+            {
+                // the highest digit in which due and now differ picks the level
+                uint64_t differ = node.due ^ current;
+                int level = 0;
+                while (level < levels - 1 && (differ >> (slotBits * (level + 1))) != 0)
+                    level++;
+                int slot = (int)(node.due >> (slotBits * level)) & (slots - 1);
+                list = level * slots + slot;
+                occupied[level][slot / 64] |= 1ull << (slot % 64);
+            }
+            node.list = list;
+            node.prev = none;
+            node.next = heads[list];
+            if (node.next != none)
+                nodes[node.next].prev = index;
+            heads[list] = index;
+        }
+
+        void unlink(uint32_t index)
+        {
+            Node &node = nodes[index];
+            if (node.prev != none)
+                nodes[node.prev].next = node.next;
+            else
+                heads[node.list] = node.next;
+            if (node.next != none)
+                nodes[node.next].prev = node.prev;
+            if (heads[node.list] == none && node.list < ready)
+                occupied[node.list / slots][node.list % slots / 64] &= ~(1ull << (node.list % 64));
+        }
+
+        void release(uint32_t index)
+        {
+            Node &node = nodes[index];
+            node.list = unused;
+            node.payload = T();
+            // skip generation 0 on wrap-around so the null handle stays unique
+            node.generation = (node.generation + 1) & TimerHandle::generationMask;
+            if (node.generation == 0)
+                node.generation = 1;
+            freeNodes.push_back(index);
+            pending--;
+        }
+
+        /// Take a whole list out of the wheel.
+        uint32_t take(uint32_t list)
+        {
+            uint32_t first = heads[list];
+            heads[list] = none;
+            if (list < ready)
+                occupied[list / slots][list % slots / 64] &= ~(1ull << (list % 64));
+            return first;
+        }
+
+        int nextOccupied(int level, int from) const
+        {
+            for (int word = from / 64; word < slots / 64; word++)
+            {
+                uint64_t bits = occupied[level][word];
+                if (word == from / 64)
+                    bits &= ~0ull << (from % 64);
+                if (bits != 0)
+                    return word * 64 + __builtin_ctzll(bits);
+            }
+            return slots;
+        }
+
+        /// At the start of a round of level 0: spread the timers of the levels whose slot came round over the finer ones.
+        void cascade()
+        {
+            int top = 1;
+            while (top < levels - 1 && (current & ((1ull << (slotBits * (top + 1))) - 1)) == 0)
+                top++;
+            // from the top, so timers cascaded into the next level's current slot move on down with it
+            for (int level = top; level >= 1; level--)
+            {
+                uint32_t index = take(level * slots + ((current >> (slotBits * level)) & (slots - 1)));
+                while (index != none)
+                {
+                    uint32_t next = nodes[index].next;
+                    insert(index, true);
+                    index = next;
+                }
+            }
+        }
+
+        template <typename Fire>
+        void fireList(uint32_t list, Fire &fire)
+        {
+            batch.clear();
+            for (uint32_t index = take(list); index != none; index = nodes[index].next)
+            {
+                nodes[index].list = firing;
+                batch.push_back({nodes[index].sequence, index});
+            }
+            std::sort(batch.begin(), batch.end());
+            for (auto &entry : batch)
+            {
+                uint32_t index = entry.second;
+                // fired and cancelled (and maybe reused) by an earlier callback of this batch
+                if (nodes[index].list != firing || nodes[index].sequence != entry.first)
+                    continue;
+                uint64_t due = nodes[index].due;
+                if (nodes[index].period != 0)
+                {
+                    // rescheduled from when it was due, so late ticks don't make it drift
+                    T payload = nodes[index].payload;
+                    nodes[index].due = due + nodes[index].period;
+                    nodes[index].sequence = nextSequence++;
+                    insert(index);
+                    fire(payload, due);
+                }
+                else
+                {
+                    T payload = std::move(nodes[index].payload);
+                    release(index);
+                    fire(payload, due);
+                }
+            }
+        }
+    };
+
+} // namespace OWL
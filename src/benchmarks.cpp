@@ -0,0 +1,526 @@
+#include "benchmarks.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "OWL/animation.h"
+#include "OWL/audio.h"
+#include "OWL/draw.h"
+#include "OWL/fov.h"
+#include "OWL/mixer.h"
+#include "OWL/msg.h"
+#include "OWL/particles.h"
+#include "OWL/save.h"
+#include "OWL/simd.h"
+
+namespace benchmarks
+{
+    static const double frameBudget = 1000.0 / 60.0; // ms
+
+    typedef std::chrono::steady_clock Clock;
+
+    static double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static void report(const char *what, double ms)
+    {
+        printf("  %-28s %8.3f ms/frame  %5.1f%% of frame budget\n", what, ms, 100.0 * ms / frameBudget);
+    }
+
+    /**
+     * Keep 500k particles alive and time the simulation, building the sprite batch, and what
+     * the CPU backend adds on top (recording the sprites, then rasterizing them on present).
+     * On the SDL backend the batch goes to the GPU as a single SDL_RenderGeometry call.
+     */
+    static int particles()
+    {
+        const int target = 500000;
+        const int frames = 300;
+        const float dt = 1.0f / 60.0f;
+
+        auto bus = std::make_shared<OWL::MessageBus>();
+        auto draw = std::make_shared<OWL::Draw>(bus, nullptr, OWL::RenderBackendType::CPU);
+        OWL::ParticleSystem system(target);
+        system.setGravity(0.0f, 30.0f);
+
+        // lifetimes average 2s, so this rate keeps the pool full once warmed up
+        OWL::Emitter emitter;
+        emitter.x = 320, emitter.y = 240;
+        emitter.lifetimeMin = 1.5f, emitter.lifetimeMax = 2.5f;
+        emitter.rate = target / 2.0f * 1.25f;
+        int id = system.addEmitter(emitter);
+        if (id < 0)
+            return 1;
+        system.burst(id, target);
+
+        double updateMs = 0, batchMs = 0, submitMs = 0, presentMs = 0;
+        size_t live = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto start = Clock::now();
+            system.update(dt);
+            updateMs += msSince(start);
+
+            start = Clock::now();
+            system.buildBatch(0);
+            batchMs += msSince(start);
+
+            // render() builds the batch again, the difference is the backend's share
+            draw->clear();
+            start = Clock::now();
+            system.render(*draw);
+            submitMs += msSince(start);
+
+            start = Clock::now();
+            draw->update();
+            presentMs += msSince(start);
+            live += system.liveCount();
+        }
+
+        printf("particles: %d frames, %zu live on average, simd %s\n", frames, live / frames, OWL::simdLevelName());
+        report("update", updateMs / frames);
+        report("build sprite batch", batchMs / frames);
+        report("total", (updateMs + batchMs) / frames);
+        printf("cpu backend:\n");
+        report("record sprites", (submitMs - batchMs) / frames);
+        report("rasterize + present", presentMs / frames);
+        return 0;
+    }
+
+    /**
+     * 100k animated sprites from one 256x256 atlas playing 8 clips at different speeds.
+     * Times the batched playback update, and what drawing the render queue costs on the
+     * CPU backend, next to drawing the same sprites with one Draw::render call each.
+     */
+    static int animation()
+    {
+        const int instances = 100000;
+        const int frames = 120;
+        const float dt = 1.0f / 60.0f;
+
+        auto bus = std::make_shared<OWL::MessageBus>();
+        auto draw = std::make_shared<OWL::Draw>(bus, nullptr, OWL::RenderBackendType::CPU);
+        OWL::TextureHandle atlas = draw->getBackend().createTexture(256, 256);
+        draw->fillTexture(atlas, 80, 160, 240, 255);
+        draw->getBackend().setTarget(OWL::TextureHandle());
+
+        // one row of 16x16 frames per clip, 4 to 11 frames at 8 to 15 fps
+        OWL::AnimationSystem system;
+        const OWL::LoopMode modes[] = {OWL::LoopMode::LOOP, OWL::LoopMode::PING_PONG, OWL::LoopMode::LOOP, OWL::LoopMode::ONCE};
+        for (int clip = 0; clip < 8; clip++)
+            system.addClip(OWL::AnimationClip::grid(atlas, 0, clip * 16, 16, 16, 16, 4 + clip, 1.0f / (8 + clip), modes[clip % 4]));
+
+        uint32_t rng = 0x2545F491;
+        for (int i = 0; i < instances; i++)
+        {
+            rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+            system.spawn(rng % 8, (float)((rng >> 8 & 1023) % 784), (float)((rng >> 18 & 1023) % 624), 1.0f, 0.5f + (rng >> 28) / 10.0f);
+        }
+
+        double updateMs = 0, submitMs = 0, presentMs = 0, naiveMs = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            auto start = Clock::now();
+            system.update(dt);
+            updateMs += msSince(start);
+
+            draw->clear();
+            start = Clock::now();
+            system.render(*draw);
+            submitMs += msSince(start);
+            start = Clock::now();
+            draw->update();
+            presentMs += msSince(start);
+
+            // the same frame, one copy per instance with the clip rect Draw::render takes
+            draw->clear();
+            start = Clock::now();
+            for (const OWL::Sprite &sprite : system.getQueue(0))
+            {
+                SDL_Rect clip = sprite.src;
+                draw->render(atlas, (int)sprite.dst.x, (int)sprite.dst.y, 0, 0, &clip);
+            }
+            draw->update();
+            naiveMs += msSince(start);
+        }
+
+        printf("animation: %zu instances, %d clips, %d frames\n", system.instanceCount(), 8, frames);
+        report("update", updateMs / frames);
+        printf("cpu backend:\n");
+        report("submit render queue", submitMs / frames);
+        report("rasterize + present", presentMs / frames);
+        report("one render() per sprite", naiveMs / frames);
+        return 0;
+    }
+
+    /**
+     * 500 viewers with radius 16 wandering a 1024x1024 map with scattered walls, while doors
+     * open and close. Each frame a tenth of the viewers take a step and 64 tiles flip. Times the
+     * incremental update against recomputing every viewer, then how many chunks a renderer
+     * could skip.
+     */
+    static int fov()
+    {
+        const int size = 1024;
+        const int viewers = 500;
+        const int radius = 16;
+        const int frames = 120;
+
+        uint32_t rng = 0x2545F491;
+        auto next = [&rng] {
+            rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+            return rng;
+        };
+        OWL::FieldOfView fov(size, size);
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++)
+                fov.setOpaque(x, y, next() % 100 < 12);
+        std::vector<OWL::ViewerHandle> handles;
+        std::vector<SDL_Point> positions;
+        for (int i = 0; i < viewers; i++)
+        {
+            positions.push_back({(int)(next() % size), (int)(next() % size)});
+            handles.push_back(fov.addViewer(positions[i].x, positions[i].y, radius));
+        }
+        fov.update();
+
+        double incrementalMs = 0, fullMs = 0;
+        size_t rescanned = 0, fullRescanned = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int i = 0; i < viewers / 10; i++)
+            {
+                int v = next() % viewers;
+                positions[v].x = std::min(std::max(positions[v].x + (int)(next() % 3) - 1, 0), size - 1);
+                positions[v].y = std::min(std::max(positions[v].y + (int)(next() % 3) - 1, 0), size - 1);
+                fov.moveViewer(handles[v], positions[v].x, positions[v].y);
+            }
+            // doors next to viewers, so they change what someone sees
+            for (int i = 0; i < 64; i++)
+            {
+                const SDL_Point &p = positions[next() % viewers];
+                int x = p.x + (int)(next() % 9) - 4, y = p.y + (int)(next() % 9) - 4;
+                fov.setOpaque(x, y, !fov.isOpaque(x, y));
+            }
+            auto start = Clock::now();
+            rescanned += fov.update();
+            incrementalMs += msSince(start);
+
+            start = Clock::now();
+            fov.invalidateAll();
+            fullRescanned += fov.update();
+            fullMs += msSince(start);
+        }
+
+        int lit = 0, explored = 0;
+        for (int cy = 0; cy < fov.chunkRows(); cy++)
+            for (int cx = 0; cx < fov.chunkColumns(); cx++)
+                lit += fov.isChunkVisible(cx, cy), explored += fov.isChunkExplored(cx, cy);
+        int chunks = fov.chunkRows() * fov.chunkColumns();
+
+        printf("fov: %dx%d map, %zu viewers of radius %d, %d frames\n", size, size, fov.viewerCount(), radius, frames);
+        report("incremental update", incrementalMs / frames);
+        printf("    %.0f of %d octants rescanned per frame\n", (double)rescanned / frames, viewers * 8);
+        report("recompute every viewer", fullMs / frames);
+        printf("    %.0f octants per frame\n", (double)fullRescanned / frames);
+        printf("chunks of %dx%d: %d visible, %d explored of %d, %.1f%% can be culled\n", OWL::FieldOfView::chunkSize,
+               OWL::FieldOfView::chunkSize, lit, explored, chunks, 100.0 * (chunks - explored) / chunks);
+        return 0;
+    }
+
+    /// A second of a stereo sine wave, for sounds that don't need files.
+    static std::vector<float> sine(int sampleRate, float frequency)
+    {
+        std::vector<float> frames((size_t)sampleRate * 2);
+        for (int i = 0; i < sampleRate; i++)
+            frames[i * 2] = frames[i * 2 + 1] = 0.25f * sinf(6.2831853f * frequency * i / sampleRate);
+        return frames;
+    }
+
+    /**
+     * 256 looping voices. First the Mixer alone, called like the audio callback would,
+     * then through a real device on SDL's dummy driver to count underruns.
+     */
+    static int audio()
+    {
+        const int voices = 256;
+        const int sampleRate = 48000;
+        const int bufferFrames = 512;
+        const int callbacks = 2000;
+
+        std::vector<OWL::Sample> sounds(8);
+        for (size_t i = 0; i < sounds.size(); i++)
+        {
+            std::vector<float> frames = sine(sampleRate, 220.0f * (i + 1));
+            sounds[i].data.resize(frames.size());
+            memcpy(sounds[i].data.data(), frames.data(), frames.size() * sizeof(float));
+            sounds[i].frames = sampleRate;
+        }
+
+        OWL::Mixer mixer(sampleRate, voices);
+        for (int i = 0; i < voices; i++)
+            mixer.push({OWL::AudioCommand::PLAY, (OWL::VoiceId)i + 1, &sounds[i % sounds.size()], 1.0f / voices, (i % 21 - 10) / 10.0f, true});
+        OWL::AlignedArray<float> out(bufferFrames * 2);
+        for (int i = 0; i < callbacks; i++)
+            mixer.process(out.data(), bufferFrames);
+
+        OWL::MixerStats s = mixer.stats();
+        printf("audio: %d voices, %d frame buffers at %d Hz, simd %s\n", s.voices, bufferFrames, sampleRate, OWL::simdLevelName());
+        printf("  mixer callback avg %8.2f us, max %8.2f us of %.0f us  (%.2f%% of the buffer)\n", s.averageMicros, s.maxMicros,
+               s.budgetMicros, 100.0 * s.averageMicros / s.budgetMicros);
+
+        // the dummy driver runs the callback on its own thread at the buffer rate, without sound hardware
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+        auto bus = std::make_shared<OWL::MessageBus>();
+        OWL::Audio device(bus, sampleRate, bufferFrames);
+        if (!device.isOpen())
+            return 1;
+        std::vector<float> tone = sine(device.getSampleRate(), 440.0f);
+        OWL::SoundHandle sound = device.create(tone.data(), device.getSampleRate());
+        for (int i = 0; i < voices; i++)
+            device.play(sound, 1.0f / voices, (i % 21 - 10) / 10.0f, true);
+        SDL_Delay(2000);
+
+        s = device.stats();
+        printf("  device (%s) %llu callbacks, avg %.2f us, max %.2f us, %llu underruns, %d voices\n", SDL_GetCurrentAudioDriver(),
+               (unsigned long long)s.callbacks, s.averageMicros, s.maxMicros, (unsigned long long)s.underruns, s.voices);
+        return 0;
+    }
+
+    static uint64_t digest(const OWL::CowBuffer &buffer)
+    {
+        OWL::snapshot::Checksum checksum;
+        for (size_t i = 0; i < buffer.chunkCount(); i++)
+            checksum.update(buffer.chunk(i).get(), OWL::snapshot::chunkSize);
+        return checksum.finish();
+    }
+
+    /// One run of the timers benchmark. Returns a digest of what was delivered, in order.
+    static uint64_t timerRun(int timers, int frames, double &scheduleMs, double &cancelMs, double &notifyMs, double &worstMs,
+                             uint64_t &fired, uint64_t &late)
+    {
+        const uint32_t frameMs = 16;
+        OWL::setManualClock(0);
+        auto bus = std::make_shared<OWL::MessageBus>();
+        uint64_t digest = 1469598103934665603ull;
+        fired = late = 0;
+        // every message carries the tick it should arrive at, periodic ones their period
+        bus->addReceiver([&](const OWL::Message &msg) {
+            uint32_t due = (uint32_t)strtoul(msg.getParameter(1).c_str(), NULL, 10);
+            uint32_t period = (uint32_t)strtoul(msg.getParameter(2).c_str(), NULL, 10);
+            uint32_t expected = period == 0 ? due : due + (msg.getTime() - due) / period * period;
+            late += msg.getTime() != expected || msg.getTime() > OWL::ticks();
+            digest = (digest ^ msg.getTime() ^ (uint64_t)due << 32) * 1099511628211ull;
+            fired++;
+        });
+
+        uint32_t rng = 0x2545F491;
+        auto next = [&rng] {
+            rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+            return rng;
+        };
+        std::vector<OWL::TimerHandle> handles;
+        handles.reserve(timers);
+        auto start = Clock::now();
+        for (int i = 0; i < timers; i++)
+        {
+            // one in ten repeats every 0.1 to 5 s, the rest fire once within 10 minutes
+            if (i % 10 == 0)
+            {
+                uint32_t period = 100 + next() % 4900;
+                handles.push_back(bus->sendEvery(OWL::Message({"timer", std::to_string(period), std::to_string(period)}), period));
+            }
+            else
+            {
+                uint32_t delay = 1 + next() % 600000;
+                handles.push_back(bus->sendDelayed(OWL::Message({"timer", std::to_string(delay), "0"}), delay));
+            }
+        }
+        scheduleMs = msSince(start);
+
+        start = Clock::now();
+        for (int i = 0; i < timers / 2; i++)
+            bus->cancelTimer(handles[next() % timers]);
+        cancelMs = msSince(start);
+
+        notifyMs = worstMs = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            OWL::advanceTicks(frameMs);
+            start = Clock::now();
+            bus->notify();
+            double ms = msSince(start);
+            notifyMs += ms;
+            worstMs = std::max(worstMs, ms);
+        }
+        return digest;
+    }
+
+    /**
+     * 300k pending delayed and periodic messages on the bus, half of them cancelled, then a
+     * minute of 16 ms frames. Times scheduling, cancelling and the per frame notify, against
+     * polling a list of all timers every frame. Runs twice to check both deliver the same.
+     */
+    static int timers()
+    {
+        const int count = 300000;
+        const int frames = 3750; // a minute
+
+        double scheduleMs, cancelMs, notifyMs, worstMs;
+        uint64_t fired, late;
+        uint64_t digest = timerRun(count, frames, scheduleMs, cancelMs, notifyMs, worstMs, fired, late);
+        double unused[4];
+        uint64_t firedAgain, lateAgain;
+        bool same = timerRun(count, frames, unused[0], unused[1], unused[2], unused[3], firedAgain, lateAgain) == digest;
+
+        printf("timers: %d scheduled, %d cancelled, %d frames of 16 ms\n", count, count / 2, frames);
+        printf("  schedule %.1f ns each, cancel %.1f ns each\n", scheduleMs * 1e6 / count, cancelMs * 1e6 / (count / 2));
+        report("notify (timer wheel)", notifyMs / frames);
+        printf("    worst frame %.3f ms, %llu messages delivered, %llu at the wrong tick\n", worstMs,
+               (unsigned long long)fired, (unsigned long long)late);
+        printf("  replay delivered the same messages in the same order: %s\n", same && fired == firedAgain ? "yes" : "NO");
+
+        // what the per frame polling it replaces costs: look at every timer, every frame
+        struct Polled
+        {
+            uint32_t due, period;
+            bool alive;
+        };
+        std::vector<Polled> polled(count);
+        uint32_t rng = 0x2545F491;
+        for (auto &timer : polled)
+        {
+            rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+            timer = {1 + rng % 600000, 0, rng % 2 == 0};
+        }
+        uint64_t polledFired = 0;
+        auto start = Clock::now();
+        for (uint32_t frame = 1; frame <= 600; frame++)
+        {
+            for (auto &timer : polled)
+            {
+                if (timer.alive && timer.due <= frame * 16)
+                {
+                    polledFired++;
+                    timer.alive = timer.period != 0;
+                    timer.due += timer.period;
+                }
+            }
+        }
+        report("polling every timer", msSince(start) / 600);
+        return polledFired == 0; // keeps the loop from being optimized away
+    }
+
+    /**
+     * A 4096x4096 map (64 MB) autosaved while the game keeps changing part of it.
+     * Shows what the game thread pays per capture and per frame of edits while the
+     * writer thread is busy, then reloads base + delta and checks it against the live map.
+     */
+    static int save()
+    {
+        const int width = 4096, height = 4096;
+        const int frames = 240, editsPerFrame = 200, autosaveEvery = 60;
+        const char *directory = "bench_saves";
+
+        auto bus = std::make_shared<OWL::MessageBus>();
+        OWL::CowBuffer map((size_t)width * height * sizeof(int32_t));
+        std::vector<int32_t> row(width);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+                row[x] = (x * 7 + y * 13) % 5;
+            map.write((size_t)y * width * sizeof(int32_t), row.data(), row.size() * sizeof(int32_t));
+        }
+
+        std::vector<double> captures;
+        double frameTotal = 0, frameMax = 0;
+        uint32_t rng = 0x2545F491;
+        {
+            OWL::SaveSystem saves(bus, directory, 0);
+            saves.addSection(OWL::snapshot::sectionId("MAP0"), map);
+            for (int frame = 0; frame < frames; frame++)
+            {
+                if (frame % autosaveEvery == 0)
+                {
+                    saves.autosave();
+                    captures.push_back(saves.lastCaptureMicros());
+                }
+                // edits land on chunks the writer may still hold, so they pay for the copy-on-write
+                auto start = Clock::now();
+                for (int i = 0; i < editsPerFrame; i++)
+                {
+                    // the action happens around a point that wanders across the map
+                    rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+                    int x = (frame * 16 + rng % 256) % width, y = (frame * 8 + (rng >> 8) % 256) % height;
+                    map.set<int32_t>(((size_t)y * width + x) * sizeof(int32_t), (int32_t)frame);
+                }
+                double ms = msSince(start);
+                frameTotal += ms;
+                frameMax = std::max(frameMax, ms);
+                saves.update();
+                bus->notify();
+            }
+            saves.autosave();
+            captures.push_back(saves.lastCaptureMicros());
+            saves.flush();
+            saves.update();
+
+            uint64_t live = digest(map);
+            auto start = Clock::now();
+            bool loaded = saves.load("autosave");
+            double loadMs = msSince(start);
+            bus->notify();
+
+            printf("save: %dx%d map, %.0f MB, %d edits per frame\n", width, height, map.size() / 1048576.0, editsPerFrame);
+            printf("  game thread capture:");
+            for (double us : captures)
+                printf(" %.0f", us);
+            printf(" us\n");
+            report("edits while saving, avg", frameTotal / frames);
+            report("edits while saving, max", frameMax);
+            printf("  load autosave (map + verify) %.1f ms, %s\n", loadMs,
+                   loaded && digest(map) == live ? "matches the live map" : "MISMATCH");
+        }
+        remove((std::string(directory) + "/autosave.base.owls").c_str());
+        remove((std::string(directory) + "/autosave.delta.owls").c_str());
+        rmdir(directory);
+        return 0;
+    }
+
+    static const std::vector<std::pair<std::string, std::function<int()>>> &all()
+    {
+        static const std::vector<std::pair<std::string, std::function<int()>>> list = {
+            {"particles", particles},
+            {"animation", animation},
+            {"fov", fov},
+            {"audio", audio},
+            {"save", save},
+            {"timers", timers},
+        };
+        return list;
+    }
+
+    int runBenchmark(const std::string &name)
+    {
+        for (const auto &bench : all())
+        {
+            if (bench.first == name)
+                return bench.second();
+        }
+        if (name != "list")
+            printf("Unknown benchmark: %s\n", name.c_str());
+        printf("Benchmarks:");
+        for (const auto &bench : all())
+            printf(" %s", bench.first.c_str());
+        printf("\n");
+        return name == "list" ? 0 : 1;
+    }
+} // namespace benchmarks
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace benchmarks
+{
+    /**
+     * @brief Run a named micro benchmark and print its timings.
+     * @details Benchmarks run headless (CPU backend where drawing is needed), single threaded
+     * unless noted, and report milliseconds per frame against the 60 fps budget.
+     * Run with ./game --bench <name>, or --bench list to see the names.
+     *
+     * @return 0 on success, 1 for an unknown name
+     */
+    int runBenchmark(const std::string &name);
+} // namespace benchmarks
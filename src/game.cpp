@@ -2,24 +2,106 @@
 
 #include "game.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <thread>
 #include "OWL/window.h"
+#include "OWL/alloc.h"
+#include "OWL/arena.h"
 
-Game::Game(const std::shared_ptr<OWL::MessageBus> msgBus) : BusNode(msgBus)
+Game::Game(const std::shared_ptr<OWL::MessageBus> msgBus, bool headless) : BusNode(msgBus), headless{headless}
 {
 }
 
 bool Game::init()
 {
-    window = OWL::createWindow("game 23", OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT);
-    draw = std::make_shared<OWL::Draw>(messageBus, window.get());
+    if (!headless)
+        window = OWL::createWindow("game 23", OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT);
+    // OWL_RENDERER=cpu picks the software rasterizer
+    const char *rendererType = getenv("OWL_RENDERER");
+    auto backendType = headless || (rendererType != nullptr && std::string(rendererType) == "cpu") ? OWL::RenderBackendType::CPU : OWL::RenderBackendType::SDL;
+    {
+        OWL::MemoryScope scope(OWL::MemoryTag::RENDER);
+        renderer = OWL::createRenderBackend(backendType, window.get(), OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT);
+        // OWL_THREADED=0 simulates and renders on the main thread, otherwise the simulation gets its own
+        const char *threaded = getenv("OWL_THREADED");
+        if (threaded == nullptr || strcmp(threaded, "0") != 0)
+        {
+            pipeline.reset(new OWL::FramePipeline());
+            draw = std::make_shared<OWL::Draw>(messageBus, std::unique_ptr<OWL::RenderBackend>(new OWL::RecordingBackend(*pipeline, renderer->name())));
+        }
+        else
+            draw = std::make_shared<OWL::Draw>(messageBus, std::move(renderer));
+    }
     console = std::make_shared<game::Console>(messageBus, draw, 0, OWL::SCREEN_HEIGHT - OWL::SCREEN_HEIGHT / 4, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT / 4);
     start = std::make_shared<game::TestScreen>(messageBus, draw, 0, 0, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT);
     input = std::make_shared<OWL::Input>(messageBus);
+    if (pipeline != nullptr)
+    {
+        OWL::FramePipeline *events = pipeline.get();
+        input->setEventSource([events](SDL_Event *e) { return events->pollEvent(e); });
+        input->setTextInputToggle([events](bool on) { events->setTextInput(on); });
+    }
+    audio = std::make_shared<OWL::Audio>(messageBus);
+
+    saves = std::make_shared<OWL::SaveSystem>(messageBus);
+    saves->addSection(OWL::snapshot::sectionId("MAP0"), start->getMap());
+    saves->addSection(OWL::snapshot::sectionId("CONS"), console->getHistory(),
+                      [this] { console->saveHistory(); }, [this] { console->loadHistory(); });
+
+    // OWL_CAPTURE=100,200 saves those frames as capture_<frame>.png
+    if (const char *frames = getenv("OWL_CAPTURE"))
+    {
+        std::stringstream list(frames);
+        std::string frame;
+        while (std::getline(list, frame, ','))
+        {
+            // only the thread that presents can read the frame back
+            if (pipeline != nullptr)
+                pipeline->captureFrame(strtoull(frame.c_str(), NULL, 10), "capture_" + frame + ".png");
+            else
+                draw->captureFrame(strtoull(frame.c_str(), NULL, 10), "capture_" + frame + ".png");
+        }
+    }
 
     auto screenSurface = SDL_GetWindowSurface(window.get());
 
+    // OWL_MEM_DUMP=<seconds> prints the memory report that often, for soak tests
+    const char *dumpSeconds = getenv("OWL_MEM_DUMP");
+    if (dumpSeconds != nullptr && atof(dumpSeconds) > 0)
+        messageBus->sendEvery(OWL::Message({":mem"}), (uint32_t)(atof(dumpSeconds) * 1000));
+
+    // OWL_TELEMETRY=<path> serves telemetry on that socket, headless runs always do
+    const char *socketPath = getenv("OWL_TELEMETRY");
+    if (socketPath != nullptr || headless)
+    {
+        telemetry = std::make_shared<OWL::Telemetry>(messageBus, socketPath != nullptr ? socketPath : "owl.sock");
+        telemetry->addCounter("frame.allocations", [this] { return (double)frameAllocations; });
+        telemetry->addCounter("arena.highwater", [] { return (double)OWL::frameArena().highWaterMark(); });
+        telemetry->addCounter("render.issued", [this] { return (double)draw->getStateStats().totalIssued(); });
+        telemetry->addCounter("render.elided", [this] { return (double)draw->getStateStats().totalElided(); });
+        telemetry->addCounter("audio.voices", [this] { return (double)audio->stats().voices; });
+        telemetry->addCounter("audio.underruns", [this] { return (double)audio->stats().underruns; });
+        telemetry->addCounter("save.capture_us", [this] { return saves->lastCaptureMicros(); });
+        telemetry->addCounter("bus.timers", [this] { return (double)messageBus->pendingTimers(); });
+        for (int i = 0; i < (int)OWL::MemoryTag::COUNT; i++)
+        {
+            auto tag = (OWL::MemoryTag)i;
+            telemetry->addCounter(std::string("mem.") + OWL::memoryTagName(tag), [tag] { return (double)OWL::heapUsage(tag).live; });
+            telemetry->addCounter(std::string("mem.") + OWL::memoryTagName(tag) + ".textures", [tag] { return (double)OWL::gpuUsage(tag).live; });
+        }
+        if (pipeline != nullptr)
+        {
+            telemetry->addCounter("pipeline.latency_avg_ms", [this] { return pipeline->latency().averageMicros / 1000.0; });
+            telemetry->addCounter("pipeline.latency_max_ms", [this] { return pipeline->latency().maxMicros / 1000.0; });
+            telemetry->addCounter("pipeline.queued", [this] { return (double)pipeline->queued(); });
+        }
+    }
+
     return true;
 }
 
@@ -31,15 +113,53 @@ void Game::run()
         std::cout << "Failed to initialize game!" << std::endl;
         return;
     }
-    while (isRunning)
+    lastFrame = std::chrono::steady_clock::now();
+    if (pipeline == nullptr)
     {
-        SDL_RenderClear(draw->renderer.get());
-        SDL_RenderSetViewport(draw->renderer.get(), NULL);
-        input->update();
-        start->update();
-        console->update();
-        messageBus->notify();
-        draw->update();
-        SDL_Delay(40);
+        while (isRunning)
+            frame();
+        return;
+    }
+
+    // SDL stays on this thread: it pumps events and replays frames until the simulation is done
+    OWL::MemoryScope scope(OWL::MemoryTag::RENDER);
+    std::thread simulation([this] {
+        while (isRunning)
+            frame();
+        pipeline->close();
+    });
+    while (!pipeline->isFinished())
+    {
+        pipeline->pumpEvents();
+        pipeline->replay(*renderer, 5);
     }
-}
\ No newline at end of file
+    simulation.join();
+}
+
+void Game::frame()
+{
+    auto frameStart = std::chrono::steady_clock::now();
+    uint64_t frameStartAllocations = OWL::threadAllocationCount();
+    draw->clear();
+    draw->setViewport(NULL);
+    input->update();
+    start->update();
+    console->update();
+    saves->update();
+    if (telemetry != nullptr)
+        telemetry->update();
+    messageBus->notify();
+    draw->update();
+    if (telemetry != nullptr)
+    {
+        auto now = std::chrono::steady_clock::now();
+        telemetry->frame(std::chrono::duration<double, std::milli>(frameStart - lastFrame).count(),
+                         std::chrono::duration<double, std::milli>(now - frameStart).count());
+        lastFrame = frameStart;
+    }
+    SDL_Delay(40);
+
+    // everything transient from this frame goes away here
+    OWL::frameArena().reset();
+    frameAllocations = OWL::threadAllocationCount() - frameStartAllocations;
+}
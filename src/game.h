@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdio.h>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <memory>
 //#include <SDL2/SDL_ttf.h>
@@ -11,27 +13,69 @@
 //#include "OWL/screen.h"
 #include "screens.h"
 #include "OWL/input.h"
+#include "OWL/audio.h"
+#include "OWL/save.h"
+#include "OWL/telemetry.h"
+#include "OWL/alloc.h"
+#include "OWL/arena.h"
+#include "OWL/frame_pipeline.h"
 
 class Game : public OWL::BusNode
 {
 public:
-    Game(const std::shared_ptr<OWL::MessageBus> msgBus);
+    /// headless runs without a window or input, on the CPU backend, driven through telemetry
+    Game(const std::shared_ptr<OWL::MessageBus> msgBus, bool headless = false);
 
     bool init();
     void run();
 
 private:
     std::shared_ptr<SDL_Window> window = nullptr;
+    // threaded rendering: frames recorded by the simulation thread are replayed on renderer by the main thread
+    std::unique_ptr<OWL::FramePipeline> pipeline = nullptr;
+    std::unique_ptr<OWL::RenderBackend> renderer = nullptr;
     std::shared_ptr<OWL::Draw> draw = nullptr;         //std::make_shared<OWL::Draw>(messageBus, window.get());
     std::shared_ptr<game::Console> console = nullptr;  //std::make_shared<game::Console>(messageBus, draw, 0, OWL::SCREEN_HEIGHT - OWL::SCREEN_HEIGHT / 4, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT / 4);
     std::shared_ptr<game::TestScreen> start = nullptr; //std::make_shared<game::StartScreen>(messageBus, draw, 0, 0, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT);
     std::shared_ptr<OWL::Input> input = nullptr;       //std::make_shared<OWL::Input>(messageBus);
+    std::shared_ptr<OWL::Audio> audio = nullptr;
+    std::shared_ptr<OWL::SaveSystem> saves = nullptr;
+    std::shared_ptr<OWL::Telemetry> telemetry = nullptr;
 
-    bool isRunning{true};
+    bool headless;
+    std::atomic<bool> isRunning{true};
+    uint64_t frameAllocations{0}; // heap allocations the last frame() made on its own thread
+    std::chrono::steady_clock::time_point lastFrame;
 
-    void onNotify(OWL::Message msg)
+    /// Simulate and draw one frame.
+    void frame();
+
+    void onNotify(const OWL::Message &msg)
     {
         if (msg.getParameter(0) == "quitgame")
             isRunning = false;
+        // steady-state frames should report 0 here, screens keep the text textures that don't change.
+        // The open console still makes its line textures every frame.
+        if (msg.getParameter(0) == ":allocs")
+            send({"frame allocations: " + std::to_string(frameAllocations) +
+                  ", arena high water: " + std::to_string(OWL::frameArena().highWaterMark()) + " bytes"});
+        // live and high-water memory per subsystem
+        if (msg.getParameter(0) == ":mem")
+            for (auto &line : OWL::memoryReport())
+                send({"mem " + line});
+        if (msg.getParameter(0) == ":timers")
+            send({"timers: " + std::to_string(messageBus->pendingTimers()) + " pending"});
+        if (msg.getParameter(0) == ":latency")
+        {
+            if (pipeline == nullptr)
+                send({"latency: rendering is not threaded"});
+            else
+            {
+                OWL::LatencyStats latency = pipeline->latency();
+                send({"input to present latency: avg " + std::to_string(latency.averageMicros / 1000.0) +
+                      " ms, max " + std::to_string(latency.maxMicros / 1000.0) + " ms over " +
+                      std::to_string(latency.samples) + " frames, " + std::to_string(pipeline->queued()) + " queued"});
+            }
+        }
     }
 };
\ No newline at end of file
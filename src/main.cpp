@@ -4,16 +4,18 @@
 #include <iostream>
 #include <memory>
 #include <SDL2/SDL_ttf.h>
+#include "benchmarks.h"
 #include "game.h"
 #include "OWL/globals.h"
 #include "OWL/msg.h"
+#include "regression.h"
 
 //=========================================================
 
 std::shared_ptr<Game> gameInstance = nullptr;
 std::shared_ptr<OWL::MessageBus> messageBus = nullptr;
 
-bool init()
+bool init(bool headless)
 {
     messageBus = std::make_shared<OWL::MessageBus>();
     if (messageBus == nullptr)
@@ -21,7 +23,7 @@ bool init()
         std::cout << "messageBus creation failed!" << std::endl;
         return false;
     }
-    gameInstance = std::make_shared<Game>(messageBus);
+    gameInstance = std::make_shared<Game>(messageBus, headless);
 
     TTF_Init();
 
@@ -37,7 +39,26 @@ void close()
 
 int main(int argc, char *argv[])
 {
-    if (!init())
+    // --golden compares headless renders against the golden images, --golden-update rewrites them
+    if (argc > 1 && (std::string(argv[1]) == "--golden" || std::string(argv[1]) == "--golden-update"))
+    {
+        TTF_Init();
+        int failed = regression::runGoldenTests(std::string(argv[1]) == "--golden-update");
+        close();
+        return failed == 0 ? 0 : 1;
+    }
+
+    // --bench <name> runs a micro benchmark, see benchmarks.cpp
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+    {
+        TTF_Init();
+        int result = benchmarks::runBenchmark(argc > 2 ? argv[2] : "list");
+        close();
+        return result;
+    }
+
+    // --headless runs without a window, watch and drive it with owlctl
+    if (!init(argc > 1 && std::string(argv[1]) == "--headless"))
     {
         std::cout << "Failed to initialize!" << std::endl;
         return -1;
@@ -0,0 +1,166 @@
+// owlctl: command line client for the telemetry socket of a running game (see OWL/telemetry.h)
+//
+//   owlctl [-s socket] [-r] [command ...]
+//
+// With commands, sends them, prints the bus messages that come back within half a second and exits.
+// Without, streams: frame lines are summed up once per second, everything else is printed as it
+// arrives, and every line typed on stdin is sent as a command. -r prints the raw protocol instead.
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+/// Per second summary of the frame lines.
+struct FrameSummary
+{
+    int frames{0};
+    double frameTotal{0}, frameMax{0}, workTotal{0}, workMax{0};
+    Clock::time_point start{Clock::now()};
+
+    void add(double frameMs, double workMs)
+    {
+        frames++;
+        frameTotal += frameMs, frameMax = std::max(frameMax, frameMs);
+        workTotal += workMs, workMax = std::max(workMax, workMs);
+    }
+
+    void printIfDue()
+    {
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds < 1.0)
+            return;
+        if (frames > 0)
+            printf("fps %5.1f  frame avg %6.2f ms max %6.2f  work avg %6.2f ms max %6.2f\n", frames / seconds,
+                   frameTotal / frames, frameMax, workTotal / frames, workMax);
+        *this = FrameSummary();
+    }
+};
+
+static bool sendLine(int fd, std::string line)
+{
+    line += "\n";
+    size_t done = 0;
+    while (done < line.size())
+    {
+        ssize_t n = send(fd, line.data() + done, line.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno != EINTR)
+            return false;
+        if (n > 0)
+            done += n;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = getenv("OWL_TELEMETRY") != nullptr ? getenv("OWL_TELEMETRY") : "owl.sock";
+    bool raw = false;
+    std::vector<std::string> commands;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            path = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0)
+            raw = true;
+        else if (strcmp(argv[i], "-h") == 0)
+        {
+            printf("usage: owlctl [-s socket] [-r] [command ...]\n");
+            return 0;
+        }
+        else
+            commands.push_back(argv[i]);
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) < 0)
+    {
+        printf("Could not connect to %s: %s\n", path.c_str(), strerror(errno));
+        return 1;
+    }
+
+    // one shot: send, then wait a little for the answers
+    bool oneShot = !commands.empty();
+    for (auto &command : commands)
+        if (!sendLine(fd, command))
+            return 1;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(500);
+
+    FrameSummary summary;
+    std::string in, typed;
+    char buffer[4096];
+    while (true)
+    {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        int timeout = 100;
+        if (oneShot)
+        {
+            timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (timeout <= 0)
+                break;
+        }
+        poll(fds, oneShot ? 1 : 2, timeout);
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0)
+            {
+                printf("disconnected\n");
+                break;
+            }
+            in.append(buffer, n);
+            size_t start = 0, end;
+            while ((end = in.find('\n', start)) != std::string::npos)
+            {
+                std::string line = in.substr(start, end - start);
+                start = end + 1;
+                unsigned long long number;
+                double frameMs, workMs;
+                if (raw)
+                    printf("%s\n", line.c_str());
+                else if (line.compare(0, 4, "msg ") == 0)
+                    printf("%s\n", line.c_str() + 4);
+                else if (sscanf(line.c_str(), "frame %llu %lf %lf", &number, &frameMs, &workMs) == 3)
+                    summary.add(frameMs, workMs);
+                else if (!oneShot)
+                    printf("%s\n", line.c_str());
+            }
+            in.erase(0, start);
+        }
+
+        if (!oneShot && (fds[1].revents & (POLLIN | POLLHUP)))
+        {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n <= 0)
+                break;
+            typed.append(buffer, n);
+            size_t end;
+            while ((end = typed.find('\n')) != std::string::npos)
+            {
+                if (end > 0 && !sendLine(fd, typed.substr(0, end)))
+                    return 1;
+                typed.erase(0, end + 1);
+            }
+        }
+
+        if (!raw && !oneShot)
+            summary.printIfDue();
+        fflush(stdout);
+    }
+    close(fd);
+    return 0;
+}
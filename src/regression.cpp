@@ -0,0 +1,158 @@
+#include "regression.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "OWL/arena.h"
+#include "OWL/capture.h"
+#include "OWL/clock.h"
+#include "OWL/draw.h"
+#include "OWL/globals.h"
+#include "OWL/msg.h"
+#include "screens.h"
+
+namespace regression
+{
+    static const char *goldenDir = "golden";
+    static const char *outputDir = "golden_out";
+    static const int channelTolerance = 2;       // channel difference that still counts as equal
+    static const double maxDifferentPixels = 0.001; // share of pixels that may differ beyond the tolerance
+
+    typedef std::vector<std::shared_ptr<OWL::Screen>> Screens;
+
+    /**
+     * @brief A scripted headless scene.
+     * @param create builds the screens the scene shows, in update order
+     * @param script sends the scripted input for a frame, in place of OWL::Input
+     */
+    struct Scene
+    {
+        std::string name;
+        int frames;
+        std::function<Screens(std::shared_ptr<OWL::MessageBus>, std::shared_ptr<OWL::Draw>)> create;
+        std::function<void(OWL::MessageBus &, int frame)> script;
+    };
+
+    static std::vector<Scene> scenes()
+    {
+        std::vector<Scene> list;
+        list.push_back({"StartScreen", 3,
+                        [](std::shared_ptr<OWL::MessageBus> bus, std::shared_ptr<OWL::Draw> draw) -> Screens {
+                            return {std::make_shared<game::StartScreen>(bus, draw, 0, 0, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT)};
+                        },
+                        [](OWL::MessageBus &, int) {}});
+        list.push_back({"TestScreen", 3,
+                        [](std::shared_ptr<OWL::MessageBus> bus, std::shared_ptr<OWL::Draw> draw) -> Screens {
+                            return {std::make_shared<game::TestScreen>(bus, draw, 0, 0, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT)};
+                        },
+                        [](OWL::MessageBus &, int) {}});
+        // open the console, fill it past one page and scroll back up a bit
+        list.push_back({"ConsoleScrollback", 40,
+                        [](std::shared_ptr<OWL::MessageBus> bus, std::shared_ptr<OWL::Draw> draw) -> Screens {
+                            return {std::make_shared<game::TestScreen>(bus, draw, 0, 0, OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT),
+                                    std::make_shared<game::Console>(bus, draw, 0, OWL::SCREEN_HEIGHT - OWL::SCREEN_HEIGHT / 4,
+                                                                    OWL::SCREEN_WIDTH, OWL::SCREEN_HEIGHT / 4)};
+                        },
+                        [](OWL::MessageBus &bus, int frame) {
+                            if (frame == 0)
+                                bus.sendMessage(OWL::Message({"inputconsole", "open"}));
+                            else if (frame <= 30)
+                                bus.sendMessage(OWL::Message({"scrollback line " + std::to_string(frame)}));
+                            else if (frame <= 33)
+                                bus.sendMessage(OWL::Message({"inputconsole", "moveup"}));
+                            else if (frame == 34)
+                                bus.sendMessage(OWL::Message({"inputconsole", "text", ":map00"}));
+                        }});
+        return list;
+    }
+
+    /// Run scene and return the average time per frame in milliseconds.
+    static double renderScene(const Scene &scene, const std::string &capturePath)
+    {
+        OWL::setManualClock(0);
+        auto bus = std::make_shared<OWL::MessageBus>();
+        auto draw = std::make_shared<OWL::Draw>(bus, nullptr, OWL::RenderBackendType::CPU);
+        Screens screens = scene.create(bus, draw);
+        draw->captureFrame(scene.frames - 1, capturePath);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < scene.frames; frame++)
+        {
+            // same order as Game::run, with the script standing in for input
+            draw->clear();
+            draw->setViewport(NULL);
+            scene.script(*bus, frame);
+            for (auto &screen : screens)
+                screen->update();
+            bus->notify();
+            draw->update();
+            OWL::frameArena().reset();
+            OWL::advanceTicks(40);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / scene.frames;
+    }
+
+    int runGoldenTests(bool update)
+    {
+        mkdir(outputDir, 0755);
+        if (update)
+            mkdir(goldenDir, 0755);
+
+        std::vector<std::string> results;
+        int failed = 0;
+        for (const auto &scene : scenes())
+        {
+            std::string actualPath = std::string(outputDir) + "/" + scene.name + ".png";
+            std::string goldenPath = std::string(goldenDir) + "/" + scene.name + ".png";
+            std::string diffPath = std::string(outputDir) + "/" + scene.name + ".diff.png";
+            // a capture left over from an earlier run must not stand in for one that failed to write
+            remove(actualPath.c_str());
+            remove(diffPath.c_str());
+            double ms = renderScene(scene, update ? goldenPath : actualPath);
+
+            char line[256];
+            OWL::Image actual, golden;
+            if (update)
+                snprintf(line, sizeof(line), "%-20s %-8s %8.3f ms/frame", scene.name.c_str(), "UPDATED", ms);
+            else if (!loadPNG(actualPath, actual))
+            {
+                snprintf(line, sizeof(line), "%-20s %-8s %8.3f ms/frame  no capture written", scene.name.c_str(), "FAIL", ms);
+                failed++;
+            }
+            else if (!loadPNG(goldenPath, golden))
+            {
+                snprintf(line, sizeof(line), "%-20s %-8s %8.3f ms/frame  no golden image, run with --golden-update",
+                         scene.name.c_str(), "FAIL", ms);
+                failed++;
+            }
+            else
+            {
+                OWL::Image diffImage;
+                OWL::ImageDiff diff = compareImages(actual, golden, channelTolerance, &diffImage);
+                bool pass = !diff.sizeMismatch && diff.differentPixels <= maxDifferentPixels * actual.pixels.size();
+                if (!pass)
+                {
+                    failed++;
+                    if (!diff.sizeMismatch)
+                        savePNG(diffImage, diffPath);
+                }
+                if (diff.sizeMismatch)
+                    snprintf(line, sizeof(line), "%-20s %-8s %8.3f ms/frame  size %dx%d, golden %dx%d", scene.name.c_str(), "FAIL", ms,
+                             actual.w, actual.h, golden.w, golden.h);
+                else
+                    snprintf(line, sizeof(line), "%-20s %-8s %8.3f ms/frame  %d pixels differ, max channel delta %d", scene.name.c_str(),
+                             pass ? "PASS" : "FAIL", ms, diff.differentPixels, diff.maxChannelDelta);
+            }
+            results.push_back(line);
+        }
+
+        printf("\n=== golden frames ===\n");
+        for (const auto &line : results)
+            printf("%s\n", line.c_str());
+        printf("%d of %d scenes failed\n", failed, (int)results.size());
+        return failed;
+    }
+} // namespace regression
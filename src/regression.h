@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+namespace regression
+{
+    /**
+     * @brief Golden-frame regression run.
+     * @details Renders a set of scripted scenes headless with the CPU backend and a manual clock,
+     * captures the last frame of each and compares it with golden/<scene>.png.
+     * Prints pass/fail and the render time of each scene.
+     * The captured frames, and a diff image for failures, are written to golden_out/.
+     *
+     * @param update write the captured frames as the new golden images instead of comparing
+     * @return number of failed scenes
+     */
+    int runGoldenTests(bool update);
+} // namespace regression
@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <iostream>
 #include "OWL/draw.h"
 #include "OWL/screen.h"
 #include "OWL/msg.h"
 #include "OWL/globals.h"
+#include "OWL/alloc.h"
+#include "OWL/arena.h"
+#include "OWL/snapshot.h"
 
 namespace game
 {
@@ -30,7 +34,7 @@ namespace game
 
         bool isOpen = false;
 
-        void callMethod(std::vector<std::string> params)
+        void callMethod(const std::vector<std::string> &params)
         {
             if (params[1] == "open")
                 openConsole();
@@ -55,14 +59,13 @@ namespace game
             if (!isOpen)
             {
                 isOpen = true;
+                // Input switches SDL's text input, on the thread that owns SDL
                 send({"inputTextEnable"});
-                SDL_StartTextInput();
             }
             else
             {
                 isOpen = false;
                 send({"inputTextDisable"});
-                SDL_StopTextInput();
             }
         }
 
@@ -107,6 +110,106 @@ namespace game
             }
             std::cout << scroll << std::endl;
         }
+        //=== save state ===
+        // The history buffer is append-only: a uint32 message count and a uint32 byte count,
+        // then per message a uint32 time, a uint32 parameter count and every parameter as
+        // a uint32 length followed by its bytes padded to 4.
+
+        OWL::CowBuffer &getHistory() { return history; }
+
+        /// Append the messages that arrived since the last call to the history buffer.
+        void saveHistory()
+        {
+            OWL::MemoryScope scope(OWL::MemoryTag::CONSOLE);
+            if (history.size() == 0)
+            {
+                history.resize(OWL::snapshot::chunkSize);
+                history.set<uint32_t>(4, 8);
+            }
+            size_t used = history.get<uint32_t>(4);
+            for (; savedMessages < msgArray.size(); savedMessages++)
+            {
+                const auto &params = msgArray[savedMessages].getParameters();
+                size_t need = 8;
+                for (const auto &param : params)
+                    need += 4 + (param.size() + 3) / 4 * 4;
+                if (used + need > history.size())
+                    history.resize(std::max(history.size() * 2, used + need));
+
+                history.set<uint32_t>(used, msgArray[savedMessages].getTime());
+                history.set<uint32_t>(used + 4, params.size());
+                used += 8;
+                for (const auto &param : params)
+                {
+                    history.set<uint32_t>(used, param.size());
+                    history.write(used + 4, param.data(), param.size());
+                    used += 4 + (param.size() + 3) / 4 * 4;
+                }
+            }
+            history.set<uint32_t>(0, savedMessages);
+            history.set<uint32_t>(4, used);
+        }
+
+        /// Replace the message history with the contents of a loaded history buffer.
+        /// A malformed buffer is dropped along with any messages read from it.
+        void loadHistory()
+        {
+            OWL::MemoryScope scope(OWL::MemoryTag::CONSOLE);
+            msgArray.clear();
+            savedMessages = 0;
+            scroll = 0;
+            scrolling = false;
+            if (history.size() == 0)
+                return;
+            // the checksum only catches accidents, so every count and length is checked against the buffer
+            const char *problem = nullptr;
+            size_t end = history.size() >= 8 ? std::min<size_t>(history.get<uint32_t>(4), history.size()) : 0;
+            uint32_t count = end >= 8 ? history.get<uint32_t>(0) : 0;
+            size_t at = 8;
+            if (end < 8)
+                problem = "too short";
+            for (uint32_t i = 0; i < count && !problem; i++)
+            {
+                if (at + 8 > end)
+                {
+                    problem = "message past the end";
+                    break;
+                }
+                uint32_t time = history.get<uint32_t>(at);
+                uint32_t paramCount = history.get<uint32_t>(at + 4);
+                at += 8;
+                // every parameter takes at least its length
+                if (paramCount > (end - at) / 4)
+                {
+                    problem = "parameter count past the end";
+                    break;
+                }
+                std::vector<std::string> params(paramCount);
+                for (auto &param : params)
+                {
+                    size_t length = at + 4 <= end ? history.get<uint32_t>(at) : 0;
+                    if (at + 4 > end || at + 4 + (length + 3) / 4 * 4 > end)
+                    {
+                        problem = "parameter past the end";
+                        break;
+                    }
+                    param.resize(length);
+                    history.read(at + 4, &param[0], length);
+                    at += 4 + (length + 3) / 4 * 4;
+                }
+                if (!problem)
+                    msgArray.push_back(OWL::Message(std::move(params), time));
+            }
+            if (problem)
+            {
+                printf("Console history rejected: %s\n", problem);
+                msgArray.clear();
+                // saveHistory() starts the buffer over
+                history.resize(0);
+            }
+            savedMessages = msgArray.size();
+        }
+
         //============================================================================
 
         /**
@@ -123,13 +226,16 @@ namespace game
                 //=== Write message array into console
                 for (int i = scroll; i < msgArray.size(); i++)
                 {
-                    std::string s;
-                    for (const auto test : msgArray[i].getParameters())
-                        s += test;
-                    std::string msgText = std::to_string(msgArray[i].getTime() / 10) + ": " + s;
-                    auto text = draw->writeText(msgText, foreground, 0, ty);
+                    // built in the frame arena, so drawing the history doesn't touch the heap
+                    char time[16];
+                    snprintf(time, sizeof(time), "%u: ", msgArray[i].getTime() / 10);
+                    OWL::frame_string msgText = OWL::makeFrameString();
+                    msgText += time;
+                    for (const auto &param : msgArray[i].getParameters())
+                        msgText += param;
+                    auto text = draw->writeText(msgText.c_str(), foreground, 0, ty);
                     // get the text size
-                    SDL_QueryTexture(text.get(), NULL, NULL, &tw, &th);
+                    draw->queryTexture(text, &tw, &th);
                     draw->render(text, 5, ty, tw / 6, th / 6);
                     // move to next line. If the console is full, only draw most recent messages.
                     ty += th / 6;
@@ -139,7 +245,7 @@ namespace game
 
                 //=== Console input ===
                 auto hashtag = draw->writeText("> ", foreground, 5, 30);
-                SDL_QueryTexture(hashtag.get(), NULL, NULL, &tw, &th);
+                draw->queryTexture(hashtag, &tw, &th);
                 draw->render(hashtag, 5, h - tw / 6, tw / 6, th / 6);
 
                 // if user has written something, render it to the console bottom
@@ -147,7 +253,7 @@ namespace game
                 {
                     //Render new text input
                     auto text = draw->writeText(inputText, foreground, 5, 30);
-                    SDL_QueryTexture(text.get(), NULL, NULL, &tw, &th);
+                    draw->queryTexture(text, &tw, &th);
                     draw->render(text, 24, h - th / 6, tw / 6, th / 6);
                 }
                 //call base class update method
@@ -156,21 +262,22 @@ namespace game
         }
 
     private:
-        std::shared_ptr<SDL_Surface> surface = nullptr;
-        std::shared_ptr<SDL_Texture> texture = nullptr;
+        OWL::TextureHandle texture;
         std::vector<OWL::Message> msgArray;     // store all messages from system
         std::string inputText = "";             // text user is currently inputting
         SDL_Color color = {100, 100, 100, 180}; // console background color
         int scroll = 0;                         // starting index for messageArray
         int tw, th;                             // text width and height
         bool scrolling = false;
+        OWL::CowBuffer history;   // msgArray as saved state, see saveHistory()
+        size_t savedMessages = 0; // messages already in history
 
         // when message is received, push it to messageArray
-        void onNotify(OWL::Message msg)
+        void onNotify(const OWL::Message &msg)
         {
-            auto params = msg.getParameters();
+            OWL::MemoryScope scope(OWL::MemoryTag::CONSOLE);
             if (msg.getParameter(0) == "inputconsole")
-                callMethod(params);
+                callMethod(msg.getParameters());
             //TODO: hide open and close console messages
             else
                 msgArray.push_back(msg);
@@ -186,20 +293,24 @@ namespace game
         void update()
         {
             //  draw->drawImageFromFile(surface, OWL::SCREEN_WIDTH / 4, OWL::SCREEN_HEIGHT / 2);
-            imageTexture = draw->createTextureFromSurface(surface);
-            SDL_QueryTexture(imageTexture.get(), NULL, NULL, &tw, &th);
-            draw->createViewport(imageTexture.get(), OWL::SCREEN_WIDTH - tw / 4, OWL::SCREEN_HEIGHT - th / 4, tw / 4, th / 4);
+            if (!imageTexture)
+                imageTexture = draw->createTextureFromSurface(surface);
+            draw->queryTexture(imageTexture, &tw, &th);
+            draw->createViewport(imageTexture, OWL::SCREEN_WIDTH - tw / 4, OWL::SCREEN_HEIGHT - th / 4, tw / 4, th / 4);
 
-            auto text = draw->writeText("THE OWL ENGINE", {255, 175, 46}, OWL::SCREEN_WIDTH / 2, 100);
-            SDL_QueryTexture(text.get(), NULL, NULL, &tw, &th);
-            draw->createViewport(text.get(), OWL::SCREEN_WIDTH / 2 - tw / 4, 100, tw / 2, th / 2);
+            // the title never changes, so its texture is made once instead of every frame
+            if (!draw->isValid(text))
+                text = draw->createText("THE OWL ENGINE", {255, 175, 46});
+            draw->queryTexture(text, &tw, &th);
+            draw->createViewport(text, OWL::SCREEN_WIDTH / 2 - tw / 4, 100, tw / 2, th / 2);
             draw->render(text, 0, 0, tw / 2, th / 2);
             Screen::update();
         }
 
     private:
-        std::shared_ptr<SDL_Surface> surface = nullptr;
-        std::shared_ptr<SDL_Texture> imageTexture = nullptr;
+        OWL::SurfaceHandle surface;
+        OWL::TextureHandle imageTexture;
+        OWL::TextureHandle text;
         int tw, th; // texture width and height
     };
 
@@ -209,25 +320,37 @@ namespace game
         TestScreen(const std::shared_ptr<OWL::MessageBus> msgBus, const std::shared_ptr<OWL::Draw> draw, int x, int y, int w, int h)
             : Screen(msgBus, draw, x, y, w, h, "TestScreen") {}
 
+        /// Map tiles as saved state, mapWidth * mapHeight int32s row by row.
+        OWL::CowBuffer &getMap() { return map; }
+
         void update()
         {
             draw->createEmptyTexture(texture, color, x, y, w, h);
 
-            auto text = draw->writeText(textString, {255, 175, 46}, OWL::SCREEN_WIDTH / 2, 100);
-            SDL_QueryTexture(text.get(), NULL, NULL, &tw, &th);
-            draw->createViewport(text.get(), OWL::SCREEN_WIDTH / 2 - tw / 4, 100, tw / 2, th / 2);
+            // the texture is only made again when textString changes
+            if (!draw->isValid(text) || textShown != textString)
+            {
+                draw->destroyTexture(text);
+                text = draw->createText(textString, {255, 175, 46});
+                textShown = textString;
+            }
+            draw->queryTexture(text, &tw, &th);
+            draw->createViewport(text, OWL::SCREEN_WIDTH / 2 - tw / 4, 100, tw / 2, th / 2);
             draw->render(text, 0, 0, tw / 2, th / 2);
             Screen::update();
         }
 
     private:
-        std::shared_ptr<SDL_Surface> surface = nullptr;
-        std::shared_ptr<SDL_Texture> texture = nullptr;
+        OWL::TextureHandle texture;
         SDL_Color color = {0, 0, 0, 255}; // console background color
         int tw, th;                       // texture width and height
         std::string textString = "Test";
+        OWL::TextureHandle text;
+        std::string textShown; // what text holds
+        static const int mapWidth = 32, mapHeight = 32;
+        OWL::CowBuffer map{mapWidth * mapHeight * sizeof(int32_t)};
 
-        void onNotify(OWL::Message msg)
+        void onNotify(const OWL::Message &msg)
         {
             if (msg.isCommand())
             {
@@ -238,11 +361,12 @@ namespace game
 
         void createMap(int mapSeed)
         {
-            int mapArray[32][32];
-
-            for (int x = 0; x < 32; x++)
-                for (int y = 0; y < 32; y++)
+            // walls around the edge, floor inside
+            for (int x = 0; x < mapWidth; x++)
+                for (int y = 0; y < mapHeight; y++)
                 {
+                    int32_t tile = x == 0 || y == 0 || x == mapWidth - 1 || y == mapHeight - 1 ? 1 : 0;
+                    map.set<int32_t>((y * mapWidth + x) * sizeof(int32_t), tile);
                 }
         }
     };